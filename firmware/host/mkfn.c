@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * mkfn - packs the FN and FN2 layers in ../src/KeyboardFn.h into
+ * ../src/KeyboardFnPacked.h for getKeyFn() in KeyboardCommon.c.
+ *
+ * usage: mkfn > ../src/KeyboardFnPacked.h
+ *
+ * Only the non-empty entries are kept in fnKeys[], row by row. For each row,
+ * fnColumns[] has a bit set for every column that has an entry, and
+ * fnOffsets[] holds the index of the first entry of the row. fnKeys[0] is
+ * the empty entry returned for the other columns.
+ */
+
+#include "KeyboardFn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LAYERS  (sizeof matrixFnZq / sizeof matrixFnZq[0])
+
+static const char* const header =
+    "/*\n"
+    " * Copyright 2016 Esrille Inc.\n"
+    " *\n"
+    " * Licensed under the Apache License, Version 2.0 (the \"License\");\n"
+    " * you may not use this file except in compliance with the License.\n"
+    " * You may obtain a copy of the License at\n"
+    " *\n"
+    " *     http://www.apache.org/licenses/LICENSE-2.0\n"
+    " *\n"
+    " * Unless required by applicable law or agreed to in writing, software\n"
+    " * distributed under the License is distributed on an \"AS IS\" BASIS,\n"
+    " * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.\n"
+    " * See the License for the specific language governing permissions and\n"
+    " * limitations under the License.\n"
+    " */\n"
+    "\n"
+    "/*\n"
+    " * Generated from KeyboardFn.h by firmware/host/mkfn; do not edit.\n"
+    " *\n"
+    " * matrixFnZq[%u][8][12][3]: %u bytes, packed: %u bytes\n"
+    " */\n"
+    "\n"
+    "#ifndef KEYBOARD_FN_PACKED_H\n"
+    "#define KEYBOARD_FN_PACKED_H\n"
+    "\n"
+    "#include <stdint.h>\n"
+    "\n";
+
+static int isEmpty(const uint8_t* keys)
+{
+    return !keys[0] && !keys[1] && !keys[2];
+}
+
+int main(void)
+{
+    unsigned count = 1;     // fnKeys[0] is the empty entry
+    unsigned columns[LAYERS][8];
+    unsigned offsets[LAYERS][8];
+    unsigned size;
+
+    for (unsigned layer = 0; layer < LAYERS; ++layer) {
+        for (unsigned row = 0; row < 8; ++row) {
+            columns[layer][row] = 0;
+            offsets[layer][row] = count;
+            for (unsigned column = 0; column < 12; ++column) {
+                if (!isEmpty(matrixFnZq[layer][row][column])) {
+                    columns[layer][row] |= 1u << column;
+                    ++count;
+                }
+            }
+        }
+    }
+    if (255 < count) {
+        fprintf(stderr, "mkfn: too many entries for uint8_t offsets: %u\n", count);
+        return EXIT_FAILURE;
+    }
+
+    size = sizeof(uint16_t) * LAYERS * 8 + LAYERS * 8 + 3 * count;
+    printf(header, (unsigned) LAYERS, (unsigned) sizeof matrixFnZq, size);
+
+    printf("static uint16_t const fnColumns[%u][8] =\n{\n", (unsigned) LAYERS);
+    for (unsigned layer = 0; layer < LAYERS; ++layer) {
+        printf("    {");
+        for (unsigned row = 0; row < 8; ++row)
+            printf("%s0x%03x", row ? ", " : "", columns[layer][row]);
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    printf("static uint8_t const fnOffsets[%u][8] =\n{\n", (unsigned) LAYERS);
+    for (unsigned layer = 0; layer < LAYERS; ++layer) {
+        printf("    {");
+        for (unsigned row = 0; row < 8; ++row)
+            printf("%s%u", row ? ", " : "", offsets[layer][row]);
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    printf("static uint8_t const fnKeys[%u][3] =\n{\n", count);
+    printf("    {0x00, 0x00, 0x00},\n");
+    for (unsigned layer = 0; layer < LAYERS; ++layer) {
+        for (unsigned row = 0; row < 8; ++row) {
+            for (unsigned column = 0; column < 12; ++column) {
+                const uint8_t* keys = matrixFnZq[layer][row][column];
+
+                if (!isEmpty(keys))
+                    printf("    {0x%02x, 0x%02x, 0x%02x},     // [%u][%u][%u]\n",
+                           keys[0], keys[1], keys[2], layer, row, column);
+            }
+        }
+    }
+    printf("};\n\n");
+
+    printf("#endif  // #ifndef KEYBOARD_FN_PACKED_H\n");
+    fprintf(stderr, "mkfn: %u bytes -> %u bytes\n", (unsigned) sizeof matrixFnZq, size);
+    return EXIT_SUCCESS;
+}
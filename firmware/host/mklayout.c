@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * mklayout - packs the layout tables in ../src/KeyboardLayouts.h into
+ * ../src/KeyboardLayoutsPacked.h for getLayoutKey() in KeyboardCommon.c.
+ *
+ * usage: mklayout > ../src/KeyboardLayoutsPacked.h
+ *
+ * Each table is stored as the entries that differ from its parent, which is
+ * either LAYOUT_NONE, the table of all zeros, or an earlier table chosen to
+ * keep the fewest entries. E.g., the other base layouts are kept as deltas
+ * against Qwerty, and a kana shift plane as deltas against the unshifted
+ * plane, where that is smaller.
+ *
+ * The entries of a table are kept in layoutKeys[], row by row, starting at
+ * layoutOffsets[]. For each row, layoutColumns[] has a bit set for every
+ * column that has an entry, and layoutRowOffsets[] holds the index of the
+ * first entry of the row relative to layoutOffsets[]. The other columns are
+ * looked up in the parent.
+ */
+
+#include "KeyboardLayouts.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLES  (LAYOUT_MAX + 1)
+
+static const char* const header =
+    "/*\n"
+    " * Copyright 2016 Esrille Inc.\n"
+    " *\n"
+    " * Licensed under the Apache License, Version 2.0 (the \"License\");\n"
+    " * you may not use this file except in compliance with the License.\n"
+    " * You may obtain a copy of the License at\n"
+    " *\n"
+    " *     http://www.apache.org/licenses/LICENSE-2.0\n"
+    " *\n"
+    " * Unless required by applicable law or agreed to in writing, software\n"
+    " * distributed under the License is distributed on an \"AS IS\" BASIS,\n"
+    " * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.\n"
+    " * See the License for the specific language governing permissions and\n"
+    " * limitations under the License.\n"
+    " */\n"
+    "\n"
+    "/*\n"
+    " * Generated from KeyboardLayouts.h by firmware/host/mklayout; do not edit.\n"
+    " *\n"
+    " * %u tables [8][12]: %u bytes, packed: %u bytes\n"
+    " */\n"
+    "\n"
+    "#ifndef KEYBOARD_LAYOUTS_PACKED_H\n"
+    "#define KEYBOARD_LAYOUTS_PACKED_H\n"
+    "\n"
+    "#include <stdint.h>\n"
+    "\n";
+
+static uint8_t const zeros[8][12];
+
+static LayoutTable getTable(unsigned layout)
+{
+    return (layout == LAYOUT_NONE) ? zeros : layoutTables[layout];
+}
+
+static unsigned countDeltas(unsigned layout, unsigned parent)
+{
+    LayoutTable table = getTable(layout);
+    LayoutTable base = getTable(parent);
+    unsigned count = 0;
+
+    for (unsigned row = 0; row < 8; ++row) {
+        for (unsigned column = 0; column < 12; ++column) {
+            if (table[row][column] != base[row][column])
+                ++count;
+        }
+    }
+    return count;
+}
+
+int main(void)
+{
+    unsigned parents[TABLES];
+    unsigned columns[TABLES][8];
+    unsigned offsets[TABLES];
+    unsigned rowOffsets[TABLES][8];
+    unsigned count = 0;
+    unsigned size;
+
+    for (unsigned layout = 0; layout < TABLES; ++layout) {
+        LayoutTable table = layoutTables[layout];
+        LayoutTable base;
+        unsigned best;
+
+        parents[layout] = LAYOUT_NONE;
+        best = countDeltas(layout, LAYOUT_NONE);
+        for (unsigned parent = 0; parent < layout; ++parent) {
+            unsigned n = countDeltas(layout, parent);
+            if (n < best) {
+                parents[layout] = parent;
+                best = n;
+            }
+        }
+
+        base = getTable(parents[layout]);
+        offsets[layout] = count;
+        for (unsigned row = 0; row < 8; ++row) {
+            columns[layout][row] = 0;
+            rowOffsets[layout][row] = count - offsets[layout];
+            for (unsigned column = 0; column < 12; ++column) {
+                if (table[row][column] != base[row][column]) {
+                    columns[layout][row] |= 1u << column;
+                    ++count;
+                }
+            }
+        }
+    }
+    if (65535 < count) {
+        fprintf(stderr, "mklayout: too many entries for uint16_t offsets: %u\n", count);
+        return EXIT_FAILURE;
+    }
+
+    size = TABLES + sizeof(uint16_t) * TABLES * 8 + sizeof(uint16_t) * TABLES + TABLES * 8 + count;
+    printf(header, (unsigned) TABLES, (unsigned) (TABLES * sizeof zeros), size);
+
+    printf("static uint8_t const layoutParents[%u] =\n{\n    ", (unsigned) TABLES);
+    for (unsigned layout = 0; layout < TABLES; ++layout) {
+        if (parents[layout] == LAYOUT_NONE)
+            printf("%sLAYOUT_NONE", layout ? ", " : "");
+        else
+            printf("%s%u", layout ? ", " : "", parents[layout]);
+    }
+    printf("\n};\n\n");
+
+    printf("static uint16_t const layoutColumns[%u][8] =\n{\n", (unsigned) TABLES);
+    for (unsigned layout = 0; layout < TABLES; ++layout) {
+        printf("    {");
+        for (unsigned row = 0; row < 8; ++row)
+            printf("%s0x%03x", row ? ", " : "", columns[layout][row]);
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    printf("static uint16_t const layoutOffsets[%u] =\n{\n    ", (unsigned) TABLES);
+    for (unsigned layout = 0; layout < TABLES; ++layout)
+        printf("%s%u", layout ? ", " : "", offsets[layout]);
+    printf("\n};\n\n");
+
+    printf("static uint8_t const layoutRowOffsets[%u][8] =\n{\n", (unsigned) TABLES);
+    for (unsigned layout = 0; layout < TABLES; ++layout) {
+        printf("    {");
+        for (unsigned row = 0; row < 8; ++row)
+            printf("%s%u", row ? ", " : "", rowOffsets[layout][row]);
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    printf("static uint8_t const layoutKeys[%u] =\n{\n", count);
+    for (unsigned layout = 0; layout < TABLES; ++layout) {
+        LayoutTable table = layoutTables[layout];
+
+        printf("    // [%u]\n", layout);
+        for (unsigned row = 0; row < 8; ++row) {
+            if (!columns[layout][row])
+                continue;
+            printf("   ");
+            for (unsigned column = 0; column < 12; ++column) {
+                if (columns[layout][row] & (1u << column))
+                    printf(" 0x%02x,", table[row][column]);
+            }
+            printf("\n");
+        }
+    }
+    printf("};\n\n");
+
+    printf("#endif  // #ifndef KEYBOARD_LAYOUTS_PACKED_H\n");
+    fprintf(stderr, "mklayout: %u bytes -> %u bytes\n", (unsigned) (TABLES * sizeof zeros), size);
+    return EXIT_SUCCESS;
+}
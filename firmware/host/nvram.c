@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <system.h>
+#include <assert.h>
+#include <string.h>
+
+/*
+ * A single RAM backed profile laid out like one profile of the NISSE flash
+ * NVRAM (bsp/pic18f47j53_nisse/nvram.c).
+ */
+static uint8_t profile[NVRAM_PROFILE_SIZE];
+
+uint8_t board_rev = 6;
+
+void InitNvram(void)
+{
+    memcpy(profile, nvram_initial_data, NVRAM_INITIAL_DATA_SIZE);
+    memset(profile + NVRAM_INITIAL_DATA_SIZE, 0, NVRAM_PROFILE_SIZE - NVRAM_INITIAL_DATA_SIZE);
+}
+
+uint8_t ReadNvram(uint8_t offset)
+{
+    assert(offset < NVRAM_PROFILE_SIZE);
+    return profile[offset];
+}
+
+void WriteNvram(uint8_t offset, uint8_t value)
+{
+    assert(offset < NVRAM_PROFILE_SIZE);
+    profile[offset] = value;
+}
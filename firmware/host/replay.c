@@ -0,0 +1,451 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * replay - feeds recorded key matrix snapshots through onPressed() and
+ * makeReport() on a PC, prints every report the firmware would have sent,
+ * and measures how much CPU time each scan takes. A report is printed in the
+ * boot protocol layout, followed by the keys beyond the sixth one if any.
+ *
+ * usage: replay [-q] [-v] [-n loops] [-p msec] [-r rev] [-s offset=value]... [trace]
+ *
+ *  -q  do not print reports
+ *  -v  print the CPU time of every scan
+ *  -n  replay the trace this many times and keep the fastest time per scan
+ *  -p  let the host take a report at most once every msec (default 0, i.e.,
+ *      the IN endpoint is free at every scan)
+ *  -r  board revision (default 6)
+ *  -s  preset an NVRAM byte before initKeyboard(), e.g. -s 3=0 for DELAY_0
+ *
+ * A trace is a text file with one matrix snapshot per line. A snapshot lists
+ * the pressed switches as row:column pairs as they are seen by onPressed().
+ * "xN" repeats the snapshot N times, "Nms" repeats it for N [msec] at the
+ * current scan rate, "." stands for a snapshot with no switch pressed,
+ * "led N" sets the host LED output report to N (hex), and '#' starts a
+ * comment. E.g.,
+ *
+ *  . x4        # idle for 4 scans
+ *  6:1 36ms    # 'A' held for 36 [msec]
+ *  led 02      # host turned caps lock on
+ *
+ * Each report is printed with the scan number and the time in [msec]. Scans
+ * the firmware skips while no key is held are counted but not run.
+ */
+
+#include "Keyboard.h"
+#include "Latency.h"
+#include "Mouse.h"
+#include "ReportQueue.h"
+#include "TapHold.h"
+
+#include <system.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_STEP_KEYS   16
+
+#define XTAL_FREQ       48000000ul
+#define TMR0_FREQ       (XTAL_FREQ / 256 / 4)
+#define TMR0_MSEC       ((TMR0_FREQ + 500) / 1000)
+
+typedef struct Step {
+    unsigned repeat;
+    unsigned msec;      // overrides repeat if set
+    int led;            // -1 if not set
+    uint8_t count;
+    uint8_t rows[MAX_STEP_KEYS];
+    uint8_t columns[MAX_STEP_KEYS];
+} Step;
+
+typedef struct Preset {
+    uint8_t offset;
+    uint8_t value;
+} Preset;
+
+static Step* steps;
+static size_t stepCount;
+
+static Preset presets[NVRAM_PROFILE_SIZE];
+static int presetCount;
+
+static uint8_t inputReport[REPORT_SIZE];
+static int8_t xmit;
+
+static unsigned long* scanTimes;
+static unsigned long maxScanCount;
+static unsigned long scanCount;
+static unsigned long reportCount;
+static unsigned long idleCount;     // scans skipped while the keyboard is idle
+static unsigned long timer0;  // Timer0 ticks
+static unsigned long pollTicks;     // Timer0 ticks between two host polls
+static unsigned long nextPoll;
+
+static unsigned long now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static int parseLine(char* line, unsigned lineno, Step* step)
+{
+    char* token;
+
+    memset(step, 0, sizeof(Step));
+    step->led = -1;
+    if ((token = strchr(line, '#')))
+        *token = '\0';
+    for (token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        unsigned row;
+        unsigned column;
+        unsigned msec;
+        char c;
+
+        if (!strcmp(token, "led")) {
+            token = strtok(NULL, " \t\r\n");
+            if (!token) {
+                fprintf(stderr, "line %u: missing LED value\n", lineno);
+                return -1;
+            }
+            step->led = (int) strtoul(token, NULL, 16) & 0xff;
+        } else if (!strcmp(token, ".")) {
+            if (!step->repeat)
+                step->repeat = 1;
+        } else if (token[0] == 'x') {
+            step->repeat = (unsigned) strtoul(token + 1, NULL, 10);
+        } else if (sscanf(token, "%u:%u%c", &row, &column, &c) == 2 && row < 8 && column < 12) {
+            if (MAX_STEP_KEYS <= step->count) {
+                fprintf(stderr, "line %u: too many keys\n", lineno);
+                return -1;
+            }
+            step->rows[step->count] = row;
+            step->columns[step->count] = column;
+            ++step->count;
+            if (!step->repeat)
+                step->repeat = 1;
+        } else if (sscanf(token, "%ums%c", &msec, &c) == 1 && strstr(token, "ms")) {
+            step->msec = msec;
+        } else {
+            fprintf(stderr, "line %u: bad token '%s'\n", lineno, token);
+            return -1;
+        }
+    }
+    return (step->repeat || step->msec || 0 <= step->led) ? 1 : 0;
+}
+
+static int loadTrace(FILE* file)
+{
+    char line[512];
+    unsigned lineno = 0;
+    size_t allocated = 0;
+
+    while (fgets(line, sizeof line, file)) {
+        Step step;
+        int result;
+
+        ++lineno;
+        result = parseLine(line, lineno, &step);
+        if (result < 0)
+            return -1;
+        if (!result)
+            continue;
+        if (allocated <= stepCount) {
+            allocated = allocated ? allocated * 2 : 256;
+            steps = realloc(steps, allocated * sizeof(Step));
+            if (!steps)
+                return -1;
+        }
+        steps[stepCount++] = step;
+        maxScanCount += step.msec ? step.msec : step.repeat;
+    }
+    return 0;
+}
+
+/*
+ * Mirror APP_KeyboardTick() and scanTask() in app_device_keyboard.c with the
+ * matrix samples replaced by the trace, one sample per scan.
+ */
+static void readMatrix(const Step* step)
+{
+    setLatencyTick((uint16_t) timer0);
+    for (uint8_t i = 0; i < step->count; ++i)
+        onPressed(step->rows[i], step->columns[i]);
+}
+
+static uint8_t* scan(const Step* step)
+{
+    readMatrix(step);
+    if (xmit == XMIT_IN_ORDER) {
+        captureKeys();
+        xmit = playMacro(inputReport);
+    } else {
+        xmit = makeReport(inputReport);
+        switch (xmit) {
+        case XMIT_BRK:
+            memset(inputReport + 2, 0, MAX_KEYS);
+            break;
+        case XMIT_NORMAL:
+            break;
+        case XMIT_IN_ORDER:
+            for (uint8_t i = 2; i < REPORT_SIZE && inputReport[i]; ++i)
+                emitKey(inputReport[i]);
+            inputReport[2] = beginMacro();
+            memset(inputReport + 3, 0, MAX_KEYS - 1);
+            break;
+        case XMIT_MACRO:
+            xmit = XMIT_IN_ORDER;
+            inputReport[0] = 0;
+            inputReport[2] = beginMacro();
+            memset(inputReport + 3, 0, MAX_KEYS - 1);
+            break;
+        default:
+            break;
+        }
+    }
+    if (!xmit)
+        return NULL;
+    return inputReport;
+}
+
+static void reset(void)
+{
+    InitNvram();
+    for (int i = 0; i < presetCount; ++i)
+        WriteNvram(presets[i].offset, presets[i].value);
+    initKeyboard();
+#ifdef ENABLE_MOUSE
+    initMouse();
+#endif
+    initReportQueue();
+    memset(inputReport, 0, sizeof inputReport);
+    xmit = XMIT_NORMAL;
+    timer0 = 0;
+    nextPoll = 0;
+}
+
+static unsigned getRepeat(const Step* step)
+{
+    unsigned repeat;
+
+    if (!step->msec)
+        return step->repeat;
+    repeat = (step->msec + scanPeriods[scan_rate] / 2) / scanPeriods[scan_rate];
+    return repeat ? repeat : 1;
+}
+
+// Lets the host take the oldest queued report if it polls the keyboard now.
+static void poll(unsigned long n, int print)
+{
+    const uint8_t* report;
+
+    if (timer0 < nextPoll || !(report = peekReport()))
+        return;
+    ++reportCount;
+    if (print) {
+        int8_t len = REPORT_SIZE;
+
+        // Keys beyond the boot report are printed only if any.
+        while (8 < len && !report[len - 1])
+            --len;
+        printf("%6lu %7lu ", n, timer0 * 1000 / TMR0_FREQ);
+        for (int8_t j = 0; j < len; ++j)
+            printf(" %02x", report[j]);
+        printf("\n");
+    }
+    dropReport();
+    if (!peekReport())
+        sendLatency((uint16_t) timer0);
+    nextPoll = timer0 + pollTicks;
+}
+
+static void replay(int print)
+{
+    unsigned long n = 0;
+
+    reset();
+    reportCount = 0;
+    idleCount = 0;
+    for (size_t i = 0; i < stepCount; ++i) {
+        const Step* step = &steps[i];
+
+        if (0 <= step->led)
+            controlLED(step->led);
+        for (unsigned r = getRepeat(step); 0 < r && n < maxScanCount; --r, ++n) {
+            unsigned long start = now();
+            unsigned long elapsed;
+            unsigned long end = timer0 + scanPeriods[scan_rate] * TMR0_MSEC;
+
+            // Mirrors the tasks APP_KeyboardTasks() runs.
+            if (xmit == XMIT_NONE && !step->count && isKeyboardIdle())
+                ++idleCount;
+            else if (xmit == XMIT_IN_ORDER && peekReport()) {
+                readMatrix(step);
+                captureKeys();
+            } else {
+                uint8_t* report = scan(step);
+                if (report) {
+                    queueReport(report);
+                    if (!peekReport())
+                        sendLatency((uint16_t) timer0);
+                }
+            }
+            elapsed = now() - start;
+
+            if (elapsed < scanTimes[n])
+                scanTimes[n] = elapsed;
+            poll(n, print);
+
+            // A macro is played back as fast as the host polls the keyboard.
+            while (xmit == XMIT_IN_ORDER && (timer0 += TMR0_MSEC) < end) {
+                if (!peekReport() && (xmit = playMacro(inputReport)))
+                    queueReport(inputReport);
+                poll(n, print);
+            }
+            timer0 = end;
+        }
+    }
+    scanCount = n;
+
+    // Let the host take what is left in the queue.
+    while (peekReport()) {
+        if (timer0 < nextPoll)
+            timer0 = nextPoll;
+        poll(n, print);
+    }
+}
+
+#if APP_MACHINE_VALUE != 0x4550
+static void printLatency(void)
+{
+    const uint16_t* histogram = getLatencyHistogram();
+
+    printf("press latency:");
+    for (int8_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        unsigned long usec = (1000000ul << (LATENCY_SHIFT + i)) / TMR0_FREQ;
+
+        if (i < LATENCY_BUCKETS - 1)
+            printf(" <%lu.%lums %u,", usec / 1000, usec % 1000 / 100, histogram[i]);
+        else
+            printf(" more %u\n", histogram[i]);
+    }
+}
+
+static void printTapHold(void)
+{
+    const TapHoldStats* stats = getTapHoldStats();
+    unsigned decisions = stats->taps + stats->holds;
+
+    if (!decisions)
+        return;
+    printf("tap/hold: %u taps, %u holds, %u keys held back, decision mean %lu ms, max %u ms\n",
+           stats->taps, stats->holds, stats->delayed, (unsigned long) (stats->total / decisions), stats->max);
+}
+#endif
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: replay [-q] [-v] [-n loops] [-p msec] [-r rev] [-s offset=value]... [trace]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* file = stdin;
+    int quiet = 0;
+    int verbose = 0;
+    long loops = 1;
+    unsigned long total = 0;
+    unsigned long slowest = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "qvn:p:r:s:")) != -1) {
+        unsigned offset;
+        unsigned value;
+
+        switch (opt) {
+        case 'q':
+            quiet = 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'n':
+            loops = strtol(optarg, NULL, 10);
+            if (loops < 1)
+                usage();
+            break;
+        case 'p':
+            pollTicks = strtoul(optarg, NULL, 10) * TMR0_FREQ / 1000;
+            break;
+        case 'r':
+            board_rev = (uint8_t) strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            if (sscanf(optarg, "%u=%u", &offset, &value) != 2 ||
+                NVRAM_PROFILE_SIZE <= offset || 255 < value ||
+                NVRAM_PROFILE_SIZE <= presetCount)
+                usage();
+            presets[presetCount].offset = offset;
+            presets[presetCount].value = value;
+            ++presetCount;
+            break;
+        default:
+            usage();
+            break;
+        }
+    }
+    if (optind + 1 < argc)
+        usage();
+    if (optind < argc && !(file = fopen(argv[optind], "r"))) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if (loadTrace(file) < 0)
+        return EXIT_FAILURE;
+    if (file != stdin)
+        fclose(file);
+
+    scanTimes = malloc((maxScanCount + 1) * sizeof(unsigned long));
+    if (!scanTimes)
+        return EXIT_FAILURE;
+    memset(scanTimes, 0xff, (maxScanCount + 1) * sizeof(unsigned long));
+    for (long i = 0; i < loops; ++i)
+        replay(!quiet && i == 0);
+
+    for (unsigned long n = 0; n < scanCount; ++n) {
+        total += scanTimes[n];
+        if (scanTimes[slowest] < scanTimes[n])
+            slowest = n;
+        if (verbose)
+            printf("scan %6lu %8lu ns\n", n, scanTimes[n]);
+    }
+    printf("scans %lu, reports %lu\n", scanCount, reportCount);
+    if (scanCount)
+        printf("cpu per scan: mean %lu ns, max %lu ns (scan %lu)\n",
+               total / scanCount, scanTimes[slowest], slowest);
+    printf("idle scans skipped: %lu\n", idleCount);
+    printf("report queue overflows: %u\n", getReportOverflowCount());
+    printf("ghost keys masked: %u\n", getGhostCount());
+#if APP_MACHINE_VALUE != 0x4550
+    printLatency();
+    printTapHold();
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stand-in for the board system.h so that the key processing code in
+ * firmware/src can be compiled and run on a PC. Only what Keyboard*.c and
+ * Mouse.c actually use is provided here.
+ */
+
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <stdint.h>
+
+#ifndef APP_MACHINE_VALUE
+#define APP_MACHINE_VALUE       0x4753
+#endif
+
+#define APP_VERSION_VALUE       0x0102
+
+extern uint8_t board_rev;
+#define BOARD_REV_VALUE         board_rev
+
+#define LED_USB_DEVICE_HID_KEYBOARD_CAPS_LOCK   2   // LED_D2
+
+#define NVRAM_INITIAL_DATA_SIZE 8
+#define NVRAM_PROFILE_SIZE      12
+
+#define NVRAM_DATA(a, b, c, d, e, f, g, h)  \
+    const uint8_t nvram_initial_data[NVRAM_INITIAL_DATA_SIZE] = { a, b, c, d, e, f, g, h }
+
+void InitNvram(void);
+uint8_t ReadNvram(uint8_t offset);
+void WriteNvram(uint8_t offset, uint8_t value);
+
+extern const uint8_t nvram_initial_data[NVRAM_INITIAL_DATA_SIZE];
+
+#endif  // SYSTEM_H
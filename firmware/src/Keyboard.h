@@ -554,6 +554,9 @@
 #define EEPROM_IME      6
 #define EEPROM_MOUSE    7
 #define EEPROM_PREFIX   8
+#define EEPROM_SCAN     9
+#define EEPROM_THUMB    10
+#define EEPROM_HOLD     11
 
 void initKeyboard(void);
 void loadKeyboardSettings(void);
@@ -567,12 +570,13 @@ void loadKanaSettings(void);
 #define MOD_PAD         4u      // Touch sensor
 
 #define BASE_ZQ         0
-#define BASE_QWERTY     1
+#define BASE_ZQ_K       1   // ZQ without the unshiftable punctuation
 #define BASE_DVORAK     5
 #define BASE_COLEMAK    2
 #define BASE_JIS        3
 #define BASE_NICOLA_F   4
-#define BASE_MAX        1
+#define BASE_QWERTY     6
+#define BASE_MAX        6
 void emitBaseName(void);
 void switchBase(void);
 
@@ -585,10 +589,47 @@ int8_t isJP(void);
 #define KANA_ROMAJI     3
 #define KANA_STICKNEY   4
 #define KANA_X6004      5
-#define KANA_MAX        0
+#define KANA_MAX        5
 void emitKanaName(void);
 void switchKana(void);
 
+/*
+ * NICOLA takes a character key and a thumb key pressed within THUMB_* [msec]
+ * of each other as one shifted character. THUMB_0 only takes the keys seen
+ * in the same scan as pressed together.
+ */
+#define THUMB_50        0
+#define THUMB_75        1
+#define THUMB_100       2
+#define THUMB_0         3
+#define THUMB_MAX       3
+void emitThumbName(void);
+void switchThumb(void);
+void pollThumbs(const uint8_t* current);
+int8_t isThumbDue(void);
+
+// Tables in the layout bank packed by host/mklayout from KeyboardLayouts.h
+#define LAYOUT_QWERTY           0
+#define LAYOUT_ZQ               1
+#define LAYOUT_DVORAK           2
+#define LAYOUT_COLEMAK          3
+#define LAYOUT_JIS              4
+#define LAYOUT_NICOLA_F         5
+#define LAYOUT_TRON             6
+#define LAYOUT_TRON_LEFT        7
+#define LAYOUT_TRON_RIGHT       8
+#define LAYOUT_NICOLA           9
+#define LAYOUT_NICOLA_LEFT      10
+#define LAYOUT_NICOLA_RIGHT     11
+#define LAYOUT_MTYPE            12
+#define LAYOUT_MTYPE_SHIFT      13
+#define LAYOUT_STICKNEY         14
+#define LAYOUT_STICKNEY_SHIFT   15
+#define LAYOUT_X6004            16
+#define LAYOUT_X6004_SHIFT      17
+#define LAYOUT_MAX              17
+#define LAYOUT_NONE             0xFF    // The empty table
+
 #define OS_PC           0   // F13 / F14
 #define OS_MAC          1   // Kana / Eisuu
 #define OS_104A         2   // Shift-Ctrl-Space / Shift-Ctlr-Backspace
@@ -629,11 +670,25 @@ void switchMod(void);
 #define DELAY_24        2
 #define DELAY_36        3
 #define DELAY_48        4
-#define DELAY_MAX       4
+#define DELAY_EAGER     5   // Press on first contact, release after 12 [msec]
+#define DELAY_MAX       5
 
 void emitDelayName(void);
 void switchDelay(void);
 
+#define SCAN_12         0   // Every 12 [msec] (legacy)
+#define SCAN_2          1   // Every 2 [msec]
+#define SCAN_1          2   // Every 1 [msec]
+#define SCAN_SOF        3   // Every 1 [msec] frame, just before the host polls
+#if APP_MACHINE_VALUE == 0x4550
+#define SCAN_MAX        SCAN_2
+#else
+#define SCAN_MAX        SCAN_SOF
+#endif
+
+void emitScanName(void);
+void switchScan(void);
+
 #define LED_LEFT            0
 #define LED_CENTER          1
 #define LED_RIGHT           2
@@ -652,7 +707,12 @@ void switchLED(void);
 #define IME_ATOK        1
 #define IME_GOOGLE      2
 #define IME_APPLE       3
-#define IME_MAX         3
+#define IME_KANA        4   // Kana input on the JIS kana keys
+#if APP_MACHINE_VALUE == 0x4550
+#define IME_MAX         IME_APPLE
+#else
+#define IME_MAX         IME_KANA
+#endif
 void emitIMEName(void);
 void switchIME(void);
 
@@ -666,6 +726,14 @@ void switchPrefixShift(void);
 
 #define VOID_KEY        14  // A key matrix index at which no key is assigned
 
+/*
+ * makeReport() fills a report of REPORT_SIZE bytes: [0] modifiers, [1]
+ * reserved, and up to MAX_KEYS usages. Only the first six usages fit in the
+ * boot protocol report.
+ */
+#define MAX_KEYS        14
+#define REPORT_SIZE     (2 + MAX_KEYS)
+
 #define XMIT_NONE       0
 #define XMIT_NORMAL     1
 #define XMIT_BRK        2
@@ -673,9 +741,14 @@ void switchPrefixShift(void);
 #define XMIT_MACRO      4
 
 void onPressed(int8_t row, uint8_t column);
+void onScanned(int8_t row, uint16_t columns);
+void captureKeys(void);
 int8_t makeReport(uint8_t* report);
+int8_t isKeyboardIdle(void);
+uint16_t getGhostCount(void);
 
 uint8_t processModKey(uint8_t key);
+uint8_t getOSKey(uint8_t key, uint8_t* mod);
 
 int8_t isKanaMode(const uint8_t* current);
 int8_t isZQMode(const uint8_t* current);
@@ -690,17 +763,28 @@ uint8_t controlZQLED(uint8_t report);
 
 uint8_t getKeyNumLock(uint8_t code);
 uint8_t getKeyBase(uint8_t code);
+void updateKeymap(void);
+void updateRomaji(void);
+uint8_t getLayoutKey(uint8_t layout, uint8_t code);
 
+/*
+ * Constant strings are played back from where they are; only the keys
+ * emitted one by one, e.g., digits, take MAX_MACRO_SIZE bytes of RAM.
+ */
 #if APP_MACHINE_VALUE == 0x4550
-#define MAX_MACRO_SIZE  132
+#define MAX_MACRO_SIZE      24
+#define MAX_MACRO_SEGMENTS  32
 #else
-#define MAX_MACRO_SIZE  254
+#define MAX_MACRO_SIZE      80
+#define MAX_MACRO_SEGMENTS  40
 #endif
 
-uint8_t beginMacro(uint8_t max);
+uint8_t beginMacro(void);
 uint8_t peekMacro(void);
 uint8_t getMacro(void);
+int8_t playMacro(uint8_t* report);
 void emitKey(uint8_t key);
+void emitModifiedKey(uint8_t key, uint8_t mod);
 void emitString(const uint8_t s[]);
 void emitStringN(const uint8_t s[], uint8_t len);
 #if APP_MACHINE_VALUE != 0x4550
@@ -709,6 +793,9 @@ void emitNumber(uint16_t n);
 
 extern uint8_t os;
 extern uint8_t prefix_shift;
+extern uint8_t scan_rate;
+extern uint8_t const scanPeriods[SCAN_MAX + 1];
+extern uint8_t stateTick;
 extern uint8_t prefix;
 extern uint8_t prefixExtra;
 extern uint8_t modifiersExtra;
@@ -15,7 +15,12 @@
  */
 
 #include "Keyboard.h"
+#include "KeyboardFnPacked.h"
+#include "KeyboardLayoutsPacked.h"
+#include "Latency.h"
 #include "Mouse.h"
+#include "ReportQueue.h"
+#include "TapHold.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -26,6 +31,7 @@ NVRAM_DATA(BASE_ZQ, KANA_ROMAJI, OS_PC, DELAY_12, MOD_DEFAULT, LED_DEFAULT, IME_
 uint8_t os;
 uint8_t mod;
 uint8_t prefix_shift;
+uint8_t scan_rate;
 uint8_t prefix;
 uint8_t prefixExtra;
 uint8_t lastExtra;
@@ -65,49 +71,118 @@ static uint8_t const modKeys[MOD_MAX + 1][MAX_MOD_KEY_NAME] =
 #endif
 };
 
-static uint8_t const matrixFn[8][12][3] =
+/*
+ * The rules processOSMode() applies to every key in a report for the
+ * selected OS. A rule replaces the key with usage and adds modifiers to
+ * report[0], or removes the key from the report if usage is 0. Each list
+ * ends with a key of 0.
+ */
+typedef struct OSRule {
+    uint8_t key;
+    uint8_t usage;
+    uint8_t modifiers;
+} OSRule;
+
+static OSRule const osRulesPC[] =
+{
+    {KEY_LANG1, KEY_F13, 0},
+    {KEY_LANG2, KEY_F14, 0},
+    {KEY_INTERNATIONAL4, KEY_SPACEBAR, 0},
+    {KEY_INTERNATIONAL5, KEY_SPACEBAR, 0},
+    {0},
+};
+
+static OSRule const osRulesMac[] =
 {
-    {{KEY_INSERT}, {KEY_F2}, {KEY_F3}, {KEY_F4}, {KEY_F5}, {KEY_F6}, {KEY_F7}, {KEY_F8}, {KEY_F9}, {KEY_MUTE}, {KEY_VOLUME_DOWN}, {KEY_PAUSE}},
-    {{KEY_LEFTCONTROL, KEY_DELETE}, {KEY_F1}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {KEY_VOLUME_UP}, {KEY_SCROLL_LOCK}},
-    {{KEY_LEFTCONTROL, KEY_LEFTSHIFT, KEY_Z}, {KEY_LEFTCONTROL, KEY_1}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {KEY_LEFTCONTROL, KEY_0}, {KEY_PRINTSCREEN}},
+    {KEY_INTERNATIONAL4, KEY_SPACEBAR, 0},
+    {KEY_INTERNATIONAL5, KEY_SPACEBAR, 0},
 #ifdef WITH_HOS
-    {{KEY_DELETE}, {KEY_LEFTCONTROL, KEY_2}, {KEY_LEFTCONTROL, KEY_3}, {KEY_LEFTCONTROL, KEY_4}, {KEY_LEFTCONTROL, KEY_5}, {0}, {0}, {KEY_LEFTCONTROL, KEY_6}, {KEY_LEFTCONTROL, KEY_7}, {KEY_LEFTCONTROL, KEY_8}, {KEY_LEFTCONTROL, KEY_9}, {KEYPAD_NUM_LOCK}},
-#else
-    {{KEY_DELETE}, {KEY_LEFTCONTROL, KEY_2}, {KEY_LEFTCONTROL, KEY_3}, {KEY_LEFTCONTROL, KEY_4}, {KEY_LEFTCONTROL, KEY_5}, {0}, {0}, {KEY_LEFTCONTROL, KEY_6}, {KEY_LEFTCONTROL, KEY_LEFTSHIFT, KEY_LEFTARROW}, {KEY_LEFTSHIFT, KEY_UPARROW}, {KEY_LEFTCONTROL, KEY_LEFTSHIFT, KEY_RIGHTARROW}, {KEYPAD_NUM_LOCK}},
+    {KEYPAD_ENTER, KEY_ENTER, 0},
 #endif
-    {{KEY_LEFTCONTROL, KEY_Q}, {KEY_LEFTCONTROL, KEY_W}, {KEY_PAGEUP}, {KEY_LEFTCONTROL, KEY_R}, {KEY_LEFTCONTROL, KEY_T}, {0}, {0}, {KEY_LEFTCONTROL, KEY_HOME}, {KEY_LEFTCONTROL, KEY_LEFTARROW}, {KEY_UPARROW}, {KEY_LEFTCONTROL, KEY_RIGHTARROW}, {KEY_LEFTCONTROL, KEY_END}},
-    {{KEY_LEFTCONTROL, KEY_A}, {KEY_LEFTCONTROL, KEY_S}, {KEY_PAGEDOWN}, {KEY_LEFTCONTROL, KEY_F}, {KEY_LEFTCONTROL, KEY_G}, {KEY_ESCAPE}, {KEY_CAPS_LOCK}, {KEY_HOME}, {KEY_LEFTARROW}, {KEY_DOWNARROW}, {KEY_RIGHTARROW}, {KEY_END}},
-    {{KEY_LEFTCONTROL, KEY_Z}, {KEY_LEFTCONTROL, KEY_X}, {KEY_LEFTCONTROL, KEY_C}, {KEY_LEFTCONTROL, KEY_V}, {KEY_LANG2}, {KEY_TAB}, {KEY_ENTER}, {KEY_LANG1}, {KEY_LEFTSHIFT, KEY_LEFTARROW}, {KEY_LEFTSHIFT, KEY_DOWNARROW}, {KEY_LEFTSHIFT, KEY_RIGHTARROW}, {KEY_LEFTSHIFT, KEY_END}},
-    {{0}, {0}, {0}, {0}, {KEY_LEFTCONTROL, KEY_BACKSPACE}, {0}, {0}, {KEY_LEFTCONTROL, KEY_SPACEBAR}, {0}, {0}, {0}, {0}}
+    {0},
 };
 
-static uint8_t const matrixFnZq[2][8][12][3] =
+// OS_MAC with MOD_CJ_MAC or MOD_SJ_MAC
+static OSRule const osRulesMacMod[] =
 {
-    /* KEY_FN */
-    {
-    {{00}, {KEY_F2}, {KEY_F3}, {KEY_F4}, {KEY_F5}, {KEY_F6}, {KEY_F7}, {KEY_F8}, {KEY_F9}, {KEY_F10}, {KEY_F11}, {00}},
-    {{KEY_ENTER}, {KEY_F1}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {KEY_F12}, {KEY_LEFTSHIFT, KEY_SEMICOLON}},
-    {{KEY_LEFTCONTROL, KEY_LEFTSHIFT, KEY_Z}, {KEY_ZQ_SOFTTAB2}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {KEY_DELETE}, {KEY_PRINTSCREEN}},
-    {{KEY_SLASH}, {00}, {KEY_ZQ_HOMEDIR}, {00}, {00}, {0}, {0}, {00}, {0}, {KEY_ZQ_SOFTTAB2}, {00}, {KEY_BACKSPACE}},
-    {{00}, {KEY_7}, {KEY_8}, {KEY_9}, {00}, {0}, {0}, {00}, {KEY_BACKSLASH}, {KEY_LEFTSHIFT, KEY_MINUS}, {KEY_EQUAL}, {00}},
-    {{KEY_0}, {KEY_4}, {KEY_5}, {KEY_6}, {00}, {KEY_END}, {KEY_HOME}, {KEY_MINUS}, {KEY_LEFTSHIFT, KEY_LEFT_BRACKET}, {KEY_LEFTSHIFT, KEY_9}, {KEY_LEFTSHIFT, KEY_0}, {KEY_LEFTSHIFT, KEY_RIGHT_BRACKET}},
-    {{KEY_PERIOD}, {KEY_1}, {KEY_2}, {KEY_3}, {KEY_GRAVE_ACCENT}, {00}, {00}, {00}, {KEY_LEFT_BRACKET}, {KEY_LEFTSHIFT, KEY_COMMA}, {KEY_LEFTSHIFT, KEY_PERIOD}, {KEY_RIGHT_BRACKET}},
-    {{KEY_LEFTSHIFT}, {KEY_RIGHTALT}, {KEY_LEFT_GUI}, {KEY_SPACEBAR}, {KEY_CAPS_LOCK}, {KEY_LEFTCONTROL}, {00}, {00}, {KEY_RIGHT_FN}, {KEY_LEFTALT}, {KEY_RIGHTALT}, {KEY_RIGHTSHIFT}}
-    },
-
-    /* KEY_FN2 */
-    {
-    {{00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}},
-    {{00}, {00}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {00}, {00}},
-    {{00}, {00}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {00}, {00}},
-    {{00}, {00}, {00}, {00}, {00}, {0}, {0}, {00}, {00}, {00}, {00}, {00}},
-    {{00}, {00}, {00}, {00}, {00}, {0}, {0}, {00}, {00}, {00}, {00}, {00}},
-    {{00}, {00}, {00}, {00}, {00}, {KEY_PRINTSCREEN}, {KEY_SCROLL_LOCK}, {KEY_LEFTARROW}, {KEY_DOWNARROW}, {KEY_UPARROW}, {KEY_RIGHTARROW}, {00}},
-    {{00}, {00}, {00}, {00}, {00}, {KEY_PAUSE}, {KEY_INSERT}, {00}, {00}, {00}, {00}, {KEY_LEFTSHIFT, KEY_INSERT}},
-    {{00}, {KEY_RIGHTALT}, {KEY_LEFTCONTROL}, {KEY_BACKSPACE}, {KEY_CAPS_LOCK}, {KEY_LEFT_GUI}, {00}, {00}, {00}, {KEY_LEFTALT}, {KEY_RIGHTALT}, {00}}
-    },
+    {KEY_INTERNATIONAL4, KEY_SPACEBAR, 0},
+    {KEY_INTERNATIONAL5, KEY_SPACEBAR, 0},
+    {KEY_APPLICATION, 0, MOD_LEFTALT},
+#ifdef WITH_HOS
+    {KEYPAD_ENTER, KEY_ENTER, 0},
+#endif
+    {0},
+};
+
+static OSRule const osRules104A[] =
+{
+    {KEY_LANG1, KEY_SPACEBAR, MOD_LEFTSHIFT | MOD_LEFTCONTROL},
+    {KEY_LANG2, KEY_BACKSPACE, MOD_LEFTSHIFT | MOD_LEFTCONTROL},
+    {KEY_INTERNATIONAL4, KEY_SPACEBAR, 0},
+    {KEY_INTERNATIONAL5, KEY_SPACEBAR, 0},
+    {0},
+};
+
+static OSRule const osRules104B[] =
+{
+    {KEY_LANG1, KEY_GRAVE_ACCENT, MOD_LEFTALT},
+    {KEY_LANG2, KEY_GRAVE_ACCENT, MOD_LEFTALT},
+    {KEY_INTERNATIONAL4, KEY_SPACEBAR, 0},
+    {KEY_INTERNATIONAL5, KEY_SPACEBAR, 0},
+    {0},
+};
+
+static OSRule const osRules109A[] =
+{
+    {KEY_LANG1, KEY_INTERNATIONAL4, MOD_LEFTSHIFT | MOD_LEFTCONTROL},
+    {KEY_LANG2, KEY_INTERNATIONAL5, MOD_LEFTSHIFT | MOD_LEFTCONTROL},
+    {0},
+};
+
+static OSRule const osRules109B[] =
+{
+    {KEY_LANG1, KEY_GRAVE_ACCENT, 0},
+    {KEY_LANG2, KEY_GRAVE_ACCENT, 0},
+    {0},
+};
+
+static OSRule const osRulesAltSpace[] =
+{
+    {KEY_LANG1, KEY_SPACEBAR, MOD_LEFTALT},
+    {KEY_LANG2, KEY_SPACEBAR, MOD_LEFTALT},
+    {0},
+};
+
+static OSRule const osRulesShiftSpace[] =
+{
+    {KEY_LANG1, KEY_SPACEBAR, MOD_LEFTSHIFT},
+    {KEY_LANG2, KEY_SPACEBAR, MOD_LEFTSHIFT},
+    {0},
 };
 
+static OSRule const* const osRuleTables[OS_SHIFT_SP + 1] =
+{
+    osRulesPC,
+    osRulesMac,
+    osRules104A,
+    osRules104B,
+    osRules109A,
+    osRules109B,
+    osRulesAltSpace,
+    osRulesShiftSpace,
+};
+
+static OSRule const* osRules = osRulesPC;
+
+// Called whenever os or mod changes.
+static void selectOSRules(void)
+{
+    if (os == OS_MAC && isMacMod())
+        osRules = osRulesMacMod;
+    else
+        osRules = osRuleTables[os];
+}
+
 static const uint8_t cmd_ls[] = {
     KEY_SPACEBAR,
     KEY_L,
@@ -159,8 +234,72 @@ static uint8_t const delayKeyNames[DELAY_MAX + 1][MAX_DELAY_KEY_NAME] =
     {KEY_D, KEY_2, KEY_4, KEY_ENTER},
     {KEY_D, KEY_3, KEY_6, KEY_ENTER},
     {KEY_D, KEY_4, KEY_8, KEY_ENTER},
+    {KEY_D, KEY_E, KEY_ENTER},
 };
 
+#define MAX_SCAN_KEY_NAME  4
+
+static uint8_t const scanKeyNames[SCAN_MAX + 1][MAX_SCAN_KEY_NAME] =
+{
+    {KEY_S, KEY_1, KEY_2, KEY_ENTER},
+    {KEY_S, KEY_2, KEY_ENTER},
+#if SCAN_1 <= SCAN_MAX
+    {KEY_S, KEY_1, KEY_ENTER},
+#endif
+#if SCAN_SOF <= SCAN_MAX
+    {KEY_S, KEY_O, KEY_F, KEY_ENTER},
+#endif
+};
+
+/*
+ * A key changes its debounced state once it has been seen in the other state
+ * for stableScans + delayScans successive scans, i.e., for about 4 [msec]
+ * (two scans in SCAN_12) plus DELAY_* [msec]. In DELAY_EAGER, a press is taken
+ * at the first scan, and a release after 12 [msec].
+ */
+static uint8_t const delayScans[SCAN_MAX + 1][DELAY_MAX + 1] =
+{
+    {0, 1, 2, 3, 4, 0},
+    {0, 6, 12, 18, 24, 0},
+#if SCAN_1 <= SCAN_MAX
+    {0, 12, 24, 36, 48, 0},
+#endif
+#if SCAN_SOF <= SCAN_MAX
+    {0, 12, 24, 36, 48, 0},
+#endif
+};
+
+static uint8_t const stableScans[SCAN_MAX + 1] =
+{
+    2,
+    3,
+#if SCAN_1 <= SCAN_MAX
+    5,
+#endif
+#if SCAN_SOF <= SCAN_MAX
+    5,
+#endif
+};
+
+// [msec] per scan at each scan rate
+uint8_t const scanPeriods[SCAN_MAX + 1] =
+{
+    12,
+    2,
+#if SCAN_1 <= SCAN_MAX
+    1,
+#endif
+#if SCAN_SOF <= SCAN_MAX
+    1,
+#endif
+};
+
+#if SCAN_1 <= SCAN_MAX
+#define COUNTER_BITS    6   // Up to 63 scans
+#else
+#define COUNTER_BITS    5   // Up to 31 scans
+#endif
+
 #define MAX_PREFIX_KEY_NAME  4
 
 static uint8_t const prefixKeyNames[PREFIXSHIFT_MAX + 1][MAX_PREFIX_KEY_NAME] =
@@ -182,29 +321,84 @@ static uint8_t const codeRev2[8][12] =
     89, 72, 73, 74, 75, 76, 79, 80, 81, 82, 83, 90,
 };
 
-typedef struct Keys {
-    uint8_t keys[6];
-} Keys;
-
+/*
+ * A macro is played back from a list of segments. emitString() and
+ * emitStringN() add a segment that refers to the constant string itself,
+ * and emitKey() appends keys to ordered_keys[] extending the last segment
+ * if it is already a run of ordered_keys[] held with the same modifiers.
+ */
+typedef struct MacroSegment {
+    const uint8_t* keys;
+    uint8_t len;
+    uint8_t mod;                // Modifiers held with every key of the segment
+} MacroSegment;
+
+static MacroSegment segments[MAX_MACRO_SEGMENTS];
+static uint8_t segmentCount;
+static uint8_t segmentIndex;    // The segment being played back
+static uint8_t segmentPos;      // The next key in segments[segmentIndex]
+static int8_t emitting;         // Non-zero while the last segment is in ordered_keys[]
 static uint8_t ordered_keys[MAX_MACRO_SIZE];
-static uint8_t ordered_pos = 0;
-static uint8_t ordered_max;
+static uint8_t ordered_len;
 
 static uint8_t currentDelay;
-static Keys keys[DELAY_MAX + 2];
-static int8_t currentKey = 0;
+
+/*
+ * Key matrix bitmaps indexed by code. counters[] holds one bit-sliced
+ * counter per key of the successive scans in which the key has been seen in
+ * the state other than its debounced state. pressMasks[] and releaseMasks[]
+ * hold the number of scans needed for a press and a release in the same
+ * bit-sliced form.
+ */
+static uint8_t matrix[12];
+static uint8_t debounced[12];
+static uint8_t counters[COUNTER_BITS][12];
+static uint8_t pressMasks[COUNTER_BITS];
+static uint8_t releaseMasks[COUNTER_BITS];
+static uint8_t busy;    // Non-zero while any key is held or being debounced
 
 static uint8_t tick;
-static uint8_t processed[8];
+static uint8_t processed[REPORT_SIZE];
 
 static uint8_t modifiers;
 static uint8_t modifiersPrev;
 uint8_t modifiersExtra;
 static uint8_t modifiersExtraPrev;
-static uint8_t current[8];
+static uint8_t current[REPORT_SIZE];
 static int8_t count;
-static uint8_t rowCount[8];
-static uint8_t columnCount[12];
+static uint16_t rowColumns[8];     // Columns seen pressed in each row
+static uint16_t heldColumns[8];    // rowColumns[] of the previous scan after masking ghosts
+static uint16_t maskedColumns[8];  // Columns masked as possible ghosts in the previous scan
+static uint16_t ghostCount;        // Keys newly masked as possible ghosts
+
+/*
+ * Key states captured while a macro is played back wait in states[] until
+ * makeReport() processes them one per scan.
+ */
+typedef struct KeyState {
+    uint8_t modifiers;
+    uint8_t modifiersExtra;
+    uint8_t keys[12];       // debounced[] without the modifier keys
+#if APP_MACHINE_VALUE != 0x4550
+    uint8_t tick;           // scanTick when the state was captured
+#endif
+} KeyState;
+
+#if APP_MACHINE_VALUE != 0x4550
+#define MAX_STATES  8
+#else
+#define MAX_STATES  4
+#endif
+
+static KeyState states[MAX_STATES];
+static uint8_t stateHead;
+static uint8_t stateCount;
+static KeyState state;      // The key state being processed
+
+#if APP_MACHINE_VALUE != 0x4550
+static uint8_t scanTick;    // Counts the scans
+uint8_t stateTick;          // The scan the key state being processed was captured at
+#endif
 
 static uint8_t led;
 
@@ -215,17 +409,44 @@ static uint8_t dualFn;  // Used for dual-role FN keys
 
 void initKeyboard(void)
 {
-    memset(keys, VOID_KEY, sizeof keys);
-    currentKey = 0;
-    memset(current, 0, 8);
+    memset(matrix, 0, sizeof matrix);
+    memset(debounced, 0, sizeof debounced);
+    memset(counters, 0, sizeof counters);
+    memset(rowColumns, 0, sizeof rowColumns);
+    memset(heldColumns, 0, sizeof heldColumns);
+    memset(maskedColumns, 0, sizeof maskedColumns);
+    busy = 0;
+    ghostCount = 0;
+    memset(&state, 0, sizeof state);
+    stateHead = stateCount = 0;
+    memset(current, 0, REPORT_SIZE);
     memset(processed, 0, 2);
-    memset(processed + 2, VOID_KEY, 6);
+    memset(processed + 2, VOID_KEY, MAX_KEYS);
     modifiers = modifiersPrev = 0;
     lastExtra = modifiersExtra = modifiersExtraPrev = 0;
     count = 2;
+    initLatency();
+    initTapHold();
     loadKeyboardSettings();
 }
 
+static void setDebounceMasks(void)
+{
+    uint8_t press;
+    uint8_t release;
+
+    if (currentDelay == DELAY_EAGER) {
+        press = 1;
+        release = delayScans[scan_rate][DELAY_12];
+    } else {
+        press = release = stableScans[scan_rate] + delayScans[scan_rate][currentDelay];
+    }
+    for (int8_t k = 0; k < COUNTER_BITS; ++k) {
+        pressMasks[k] = (press & (1u << k)) ? 0xff : 0;
+        releaseMasks[k] = (release & (1u << k)) ? 0xff : 0;
+    }
+}
+
 void loadKeyboardSettings(void)
 {
     os = ReadNvram(EEPROM_OS);
@@ -240,8 +461,15 @@ void loadKeyboardSettings(void)
     prefix_shift = ReadNvram(EEPROM_PREFIX);
     if (PREFIXSHIFT_MAX < prefix_shift)
         prefix_shift = 0;
+    scan_rate = ReadNvram(EEPROM_SCAN);
+    if (SCAN_MAX < scan_rate)
+        scan_rate = 0;
+    setDebounceMasks();
     loadBaseSettings();
     loadKanaSettings();
+    loadTapHoldSettings();
+    updateKeymap();
+    selectOSRules();
 }
 
 void emitOSName(void)
@@ -255,6 +483,7 @@ void switchOS(void)
     if (OS_MAX < os)
         os = 0;
     WriteNvram(EEPROM_OS, os);
+    selectOSRules();
     emitOSName();
 }
 
@@ -269,6 +498,8 @@ void switchMod(void)
     if (MOD_MAX < mod)
         mod = 0;
     WriteNvram(EEPROM_MOD, mod);
+    updateKeymap();
+    selectOSRules();
     emitModName();
 }
 
@@ -283,9 +514,27 @@ void switchDelay(void)
     if (DELAY_MAX < currentDelay)
         currentDelay = 0;
     WriteNvram(EEPROM_DELAY, currentDelay);
+    setDebounceMasks();
+    initLatency();
     emitDelayName();
 }
 
+void emitScanName(void)
+{
+    emitStringN(scanKeyNames[scan_rate], MAX_SCAN_KEY_NAME);
+}
+
+void switchScan(void)
+{
+    ++scan_rate;
+    if (SCAN_MAX < scan_rate)
+        scan_rate = 0;
+    WriteNvram(EEPROM_SCAN, scan_rate);
+    setDebounceMasks();
+    initLatency();
+    emitScanName();
+}
+
 void emitPrefixShift(void)
 {
     emitStringN(prefixKeyNames[prefix_shift], MAX_PREFIX_KEY_NAME);
@@ -304,104 +553,263 @@ void switchPrefixShift(void)
 
 void onPressed(int8_t row, uint8_t column)
 {
-    uint8_t key;
+    rowColumns[row] |= 1u << column;
+}
+
+// Takes the columns pressed in a row as a bitmap (bit n for column n).
+void onScanned(int8_t row, uint16_t columns)
+{
+    rowColumns[row] |= columns;
+}
+
+static void readKey(int8_t row, uint8_t column)
+{
     uint8_t code;
 
     if (2 <= BOARD_REV_VALUE)
         code = codeRev2[row][column];
     else
         code = 12 * row + column;
-    ++columnCount[column];
-    ++rowCount[row];
-    key = getKeyBase(code);
-    if (KEY_LEFTCONTROL <= key && key <= KEY_RIGHT_GUI) {
+    if (code != VOID_KEY)
+        matrix[code >> 3] |= 1u << (code & 7);
+}
+
+// Returns non-zero if key, a base key, is a modifier rather than a key to report.
+static int8_t isModifierKey(uint8_t key)
+{
+    return (KEY_LEFTCONTROL <= key && key <= KEY_RIGHT_GUI) || (KEY_LEFT_FN <= key && key <= KEY_FN2);
+}
+
+/*
+ * Adds the modifier of the debounced key at code to modifiers or
+ * modifiersExtra, and returns non-zero if code is a modifier key.
+ */
+static int8_t readModifier(uint8_t code)
+{
+    uint8_t key = getKeyBase(code);
+
+    if (!isModifierKey(key))
+        return 0;
+    if (key <= KEY_RIGHT_GUI)
         modifiers |= 1u << (key - KEY_LEFTCONTROL);
-        return;
-    }
-    if (KEY_RIGHT_FN == key) {
+    else if (KEY_RIGHT_FN == key)
         modifiersExtra |= MOD_FN;
-        return;
-    }
-    if (KEY_FN2 == key) {
+    else if (KEY_FN2 == key)
         modifiersExtra |= MOD_FN2;
-        return;
-    }
-    if (KEY_LEFT_FN <= key && key <= KEY_RIGHT_FN) {
+    else
         current[1] |= 1u << (key - KEY_LEFT_FN);
-        return;
-    }
-    if (count < 8)
-        current[count++] = code;
+    return 1;
 }
 
-static int8_t detectGhost(void)
+/*
+ * Masks ghost keys. When three corners of a rectangle in the key matrix are
+ * pressed, the fourth corner is seen pressed as well. So where two rows share
+ * two or more columns, any of the keys at those columns can be a ghost, and
+ * the ones that were not held in the previous scan are masked until the
+ * rectangle is broken. All the other keys pass through.
+ */
+static void maskGhosts(void)
 {
-    uint8_t i;
-    int8_t detected;
-    uint8_t rx = 0;
-    uint8_t cx = 0;
-
-    for (i = 0; i < sizeof rowCount; ++i) {
-        if (2 <= rowCount[i])
-            ++rx;
+    uint16_t ambiguous[8];
+
+    memset(ambiguous, 0, sizeof ambiguous);
+    for (int8_t i = 0; i < 7; ++i) {
+        if (!(rowColumns[i] & (rowColumns[i] - 1)))
+            continue;
+        for (int8_t j = i + 1; j < 8; ++j) {
+            uint16_t shared = rowColumns[i] & rowColumns[j];
+            if (shared & (shared - 1)) {
+                ambiguous[i] |= shared;
+                ambiguous[j] |= shared;
+            }
+        }
     }
-    for (i = 0; i < sizeof columnCount; ++i) {
-        if (2 <= columnCount[i])
-            ++cx;
+    for (int8_t i = 0; i < 8; ++i) {
+        uint16_t masked = ambiguous[i] & rowColumns[i] & ~heldColumns[i];
+        uint16_t fresh = masked & ~maskedColumns[i];
+
+        rowColumns[i] &= ~masked;
+        // Count a key once however many scans it stays masked.
+        for (; fresh; fresh &= fresh - 1) {
+            if (ghostCount < UINT16_MAX)
+                ++ghostCount;
+        }
+        heldColumns[i] = rowColumns[i];
+        maskedColumns[i] = masked;
     }
-    detected = (2 <= rx && 2 <= cx);
-    memset(rowCount, 0, sizeof rowCount);
-    memset(columnCount, 0, sizeof columnCount);
-    return detected;
 }
 
-uint8_t beginMacro(uint8_t max)
+uint16_t getGhostCount(void)
+{
+    return ghostCount;
+}
+
+#if APP_MACHINE_VALUE != 0x4550
+static const uint8_t about_ghost[] = {
+    KEY_G, KEY_H, KEY_O, KEY_S, KEY_T, KEY_SPACEBAR, 0
+};
+
+static void emitGhostCount(void)
 {
-    ordered_pos = 1;
-    ordered_max = max;
-    return ordered_keys[0];
+    emitString(about_ghost);
+    emitNumber(ghostCount);
+    emitKey(KEY_ENTER);
+}
+#endif
+
+uint8_t beginMacro(void)
+{
+    uint8_t key;
+
+    segmentIndex = segmentPos = 0;
+    key = peekMacro();
+    ++segmentPos;
+    return key;
 }
 
 uint8_t peekMacro(void)
 {
-    if (ordered_pos < ordered_max)
-        return ordered_keys[ordered_pos];
+    for (; segmentIndex < segmentCount; ++segmentIndex, segmentPos = 0) {
+        if (segmentPos < segments[segmentIndex].len)
+            return segments[segmentIndex].keys[segmentPos];
+    }
     return 0;
 }
 
 uint8_t getMacro(void)
 {
-    if (ordered_pos < ordered_max) {
-        uint8_t key = ordered_keys[ordered_pos++];
-        if (key)
-            return key;
+    uint8_t key = peekMacro();
+
+    if (key) {
+        ++segmentPos;
+        return key;
     }
-    ordered_pos = ordered_max = 0;
+    segmentCount = segmentIndex = segmentPos = 0;
+    ordered_len = 0;
+    emitting = 0;
     return 0;
 }
 
+// Returns the usage ID to send for key and sets the modifiers it needs in *mod.
+static uint8_t getMacroUsage(uint8_t key, uint8_t* mod)
+{
+    *mod = MOD_LEFTSHIFT;
+    switch (key) {
+#if APP_MACHINE_VALUE != 0x4550
+    case KEYPAD_PERCENT:
+        return KEY_5;
+#endif
+    case KEY_ZQ_MACRO_TILDE:
+        return KEY_GRAVE_ACCENT;
+    case KEY_ZQ_MACRO_ASTERISK:
+        return KEY_8;
+    case KEY_ZQ_MACRO_PIPE:
+        return KEY_BACKSLASH;
+    case KEY_ZQ_MACRO_BANG:
+        return KEY_1;
+    case KEY_ZQ_MACRO_DQUOTE:
+        return KEY_QUOTE;
+    case KEY_ZQ_MACRO_GT:
+        return KEY_PERIOD;
+    case KEY_ZQ_MACRO_CAP_E:
+        return KEY_E;
+    default:
+        *mod = 0;
+        return key;
+    }
+}
+
+// Returns the usage ID to send for the next key of the macro and its modifiers.
+static uint8_t peekMacroUsage(uint8_t* mod)
+{
+    uint8_t key = getMacroUsage(peekMacro(), mod);
+
+    if (key)
+        *mod |= segments[segmentIndex].mod;
+    return key;
+}
+
+/*
+ * Places the next keys of the macro in report. Consecutive keys that need
+ * the same modifiers share one report as long as their usage IDs ascend, so
+ * that a host walking the report from the first key, or the bitmap from the
+ * lowest usage, sees them in the order they were emitted. A key still held
+ * in report is released before it is pressed again, and every key is
+ * released at the end of the macro. Returns XMIT_NONE once the macro is over.
+ */
+int8_t playMacro(uint8_t* report)
+{
+    uint8_t keys[6];
+    int8_t n = 0;
+    uint8_t mod;
+    uint8_t next;
+    uint8_t key = peekMacroUsage(&mod);
+
+    if (!key) {
+        getMacro();
+        if (!report[0] && !report[2])
+            return XMIT_NONE;
+        memset(report, 0, REPORT_SIZE);
+        return XMIT_IN_ORDER;
+    }
+    if (memchr(report + 2, key, MAX_KEYS)) {
+        memset(report + 2, 0, MAX_KEYS);    // BRK
+        return XMIT_IN_ORDER;
+    }
+    for (;;) {
+        getMacro();
+        keys[n++] = key;
+        key = peekMacroUsage(&next);
+        if (n == sizeof keys || !key || next != mod || key <= keys[n - 1] ||
+            memchr(report + 2, key, MAX_KEYS))
+            break;
+    }
+    report[0] = mod;
+    memset(report + 2, 0, MAX_KEYS);
+    memcpy(report + 2, keys, n);
+    return XMIT_IN_ORDER;
+}
+
 void emitKey(uint8_t c)
 {
-    if (ordered_pos < sizeof ordered_keys)
-        ordered_keys[ordered_pos++] = c;
-    if (ordered_pos < sizeof ordered_keys)
-        ordered_keys[ordered_pos] = 0;
+    emitModifiedKey(c, 0);
+}
+
+void emitModifiedKey(uint8_t c, uint8_t mod)
+{
+    if (ordered_len == sizeof ordered_keys)
+        return;
+    if (!emitting || segments[segmentCount - 1].mod != mod) {
+        if (segmentCount == MAX_MACRO_SEGMENTS)
+            return;
+        segments[segmentCount].keys = ordered_keys + ordered_len;
+        segments[segmentCount].len = 0;
+        segments[segmentCount].mod = mod;
+        ++segmentCount;
+        emitting = 1;
+    }
+    ordered_keys[ordered_len++] = c;
+    ++segments[segmentCount - 1].len;
 }
 
 void emitString(const uint8_t s[])
 {
-    uint8_t i = 0;
-    uint8_t c;
-    for (c = s[i]; c; c = s[++i])
-        emitKey(c);
+    emitStringN(s, 255);
 }
 
 void emitStringN(const uint8_t s[], uint8_t len)
 {
-    uint8_t i = 0;
-    uint8_t c;
-    for (c = s[i]; i < len && c; c = s[++i])
-        emitKey(c);
+    uint8_t i;
+
+    for (i = 0; i < len && s[i]; ++i)
+        ;
+    if (i && segmentCount < MAX_MACRO_SEGMENTS) {
+        segments[segmentCount].keys = s;
+        segments[segmentCount].len = i;
+        segments[segmentCount].mod = 0;
+        ++segmentCount;
+        emitting = 0;
+    }
 }
 
 static uint8_t getNumKeycode(unsigned int n)
@@ -545,14 +953,24 @@ static void about(void)
     // F4 Kana Layout
     emitString(about_f4);
     emitKanaName();
+#if APP_MACHINE_VALUE != 0x4550
+    emitString(about_f4);
+    emitThumbName();
+#endif
 
     // F5 Delay
     emitString(about_f5);
     emitDelayName();
+    emitString(about_f5);
+    emitScanName();
 
     // F6 Modifiers
     emitString(about_f6);
     emitModName();
+#if APP_MACHINE_VALUE != 0x4550
+    emitString(about_f6);
+    emitHoldName();
+#endif
 
     // F7 IME
     emitString(about_f7);
@@ -590,13 +1008,54 @@ static void about(void)
 #endif
 }
 
+static uint8_t const bitCounts[16] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+static uint8_t countBits(uint16_t bits)
+{
+    return bitCounts[bits & 15] + bitCounts[(bits >> 4) & 15] + bitCounts[bits >> 8];
+}
+
+/*
+ * Looks up the FN or FN2 layer packed by host/mkfn. The entries of a row
+ * are stored in the order of their columns, so the entry for a column
+ * follows as many entries as there are bits set below it in fnColumns[].
+ */
 static const uint8_t* getKeyFn(uint8_t code, uint8_t matrixNumber)
 {
+    uint8_t row = code / 12;
+    uint16_t bit = 1u << (code % 12);
+    uint16_t below;
+
     if (is109()) {
         if (12 * 6 + 8 <= code && code <= 12 * 6 + 11)
             return matrixFn109[code - (12 * 6 + 8)];
     }
-    return matrixFnZq[matrixNumber][code / 12][code % 12];
+    if (!(fnColumns[matrixNumber][row] & bit))
+        return fnKeys[0];
+    below = fnColumns[matrixNumber][row] & (bit - 1);
+    return fnKeys[fnOffsets[matrixNumber][row] + countBits(below)];
+}
+
+/*
+ * Looks up a table in the layout bank packed by host/mklayout. A column
+ * without an entry in the table is looked up in its parent, down to
+ * LAYOUT_NONE.
+ */
+uint8_t getLayoutKey(uint8_t layout, uint8_t code)
+{
+    uint8_t row = code / 12;
+    uint16_t bit = 1u << (code % 12);
+    uint16_t columns;
+
+    while (layout != LAYOUT_NONE) {
+        columns = layoutColumns[layout][row];
+        if (columns & bit)
+            return layoutKeys[layoutOffsets[layout] + layoutRowOffsets[layout][row] + countBits(columns & (bit - 1))];
+        layout = layoutParents[layout];
+    }
+    return 0;
 }
 
 #ifdef WITH_HOS
@@ -614,9 +1073,9 @@ static int8_t processKeys(const uint8_t* current, uint8_t* processed, uint8_t* r
 {
     int8_t xmit;
 
-    if (!memcmp(current, processed, 8))
+    if (!memcmp(current, processed, REPORT_SIZE))
         return XMIT_NONE;
-    memset(report, 0, 8);
+    memset(report, 0, REPORT_SIZE);
 
     if (lastExtra & MOD_FN)
         modifiersExtra |= MOD_FN;
@@ -632,12 +1091,12 @@ static int8_t processKeys(const uint8_t* current, uint8_t* processed, uint8_t* r
         uint8_t count = 2;
         xmit = XMIT_NORMAL;
 
-        for (int8_t i = 2; i < 8 && xmit != XMIT_MACRO; ++i) {
+        for (int8_t i = 2; i < REPORT_SIZE && xmit != XMIT_MACRO; ++i) {
             uint8_t code = current[i];
             const uint8_t* a = getKeyFn(code, MOD_FN - 1);
-            for (int8_t j = 0; j < 3 && count < 8; ++j) {
+            for (int8_t j = 0; j < 3 && count < REPORT_SIZE; ++j) {
                 uint8_t key = a[j];
-                int8_t make = !memchr(processed + 2, code, 6);
+                int8_t make = !memchr(processed + 2, code, MAX_KEYS);
 
                 switch (key) {
                 case 0:
@@ -701,20 +1160,40 @@ static int8_t processKeys(const uint8_t* current, uint8_t* processed, uint8_t* r
                         else
 #endif
                         {
-                            switchKana();
+#if APP_MACHINE_VALUE != 0x4550
+                            if (current[0] & MOD_CONTROL)
+                                switchThumb();
+                            else
+#endif
+                                switchKana();
                             xmit = XMIT_MACRO;
                         }
                     }
                     break;
                 case KEY_F5:
                     if (make) {
-                        switchDelay();
+                        if (current[0] & MOD_CONTROL)
+                            switchScan();
+#if APP_MACHINE_VALUE != 0x4550
+                        else if (current[0] & MOD_SHIFT) {
+                            emitLatency();
+                            emitGhostCount();
+                            emitReportOverflowCount();
+                        }
+#endif
+                        else
+                            switchDelay();
                         xmit = XMIT_MACRO;
                     }
                     break;
                 case KEY_F6:
                     if (make) {
-                        switchMod();
+#if APP_MACHINE_VALUE != 0x4550
+                        if (current[0] & MOD_CONTROL)
+                            switchHold();
+                        else
+#endif
+                            switchMod();
                         xmit = XMIT_MACRO;
                     }
                     break;
@@ -804,12 +1283,12 @@ static int8_t processKeys(const uint8_t* current, uint8_t* processed, uint8_t* r
         uint8_t modifiers = current[0];
         uint8_t count = 2;
         xmit = XMIT_NORMAL;
-        for (int8_t i = 2; i < 8 && xmit != XMIT_MACRO; ++i) {
+        for (int8_t i = 2; i < REPORT_SIZE && xmit != XMIT_MACRO; ++i) {
             uint8_t code = current[i];
             const uint8_t* a = getKeyFn(code, MOD_FN2 - 1);
-            for (int8_t j = 0; j < 3 && count < 8; ++j) {
+            for (int8_t j = 0; j < 3 && count < REPORT_SIZE; ++j) {
                 uint8_t key = a[j];
-                int8_t make = !memchr(processed + 2, code, 6);
+                int8_t make = !memchr(processed + 2, code, MAX_KEYS);
                 switch (key) {
                 case 0:
                     break;
@@ -853,7 +1332,7 @@ static int8_t processKeys(const uint8_t* current, uint8_t* processed, uint8_t* r
                 uint8_t key = (dualFn & MOD_RIGHTFN) ? KEY_LANG1 : KEY_LANG2;
                 key = toggleKanaMode(key, current[0], 1);
                 report[2] = key;
-                memmove(processed, current, 8);
+                memmove(processed, current, REPORT_SIZE);
                 processed[1] |= dualFn;
                 dualFn = 0;
                 return xmit;
@@ -866,137 +1345,44 @@ static int8_t processKeys(const uint8_t* current, uint8_t* processed, uint8_t* r
 #endif
 
     if (xmit == XMIT_NORMAL || xmit == XMIT_IN_ORDER || xmit == XMIT_MACRO)
-        memmove(processed, current, 8);
+        memmove(processed, current, REPORT_SIZE);
 
     return xmit;
 }
 
+/*
+ * Returns the usage ID to send for key under the selected OS, or 0 if it is
+ * not to be sent, and adds the modifiers it needs to *mod.
+ */
+uint8_t getOSKey(uint8_t key, uint8_t* mod)
+{
+    for (const OSRule* rule = osRules; rule->key; ++rule) {
+        if (key == rule->key) {
+            *mod |= rule->modifiers;
+            return rule->usage;
+        }
+    }
+    return key;
+}
+
+/*
+ * Applies the OS rules to every key in the report. Since an earlier stage can
+ * leave a zero slot before other keys, every slot is checked, and the keys
+ * left are packed to the front for the boot report.
+ */
 static void processOSMode(uint8_t* report)
 {
-    for (int8_t i = 2; i < 8; ++i) {
+    int8_t n = 2;
+
+    for (int8_t i = 2; i < REPORT_SIZE; ++i) {
         uint8_t key = report[i];
-        switch (os) {
-        case OS_PC:
-            switch (key) {
-            case KEY_LANG1:
-                report[i] = KEY_F13;
-                break;
-            case KEY_LANG2:
-                report[i] = KEY_F14;
-                break;
-            case KEY_INTERNATIONAL4:
-            case KEY_INTERNATIONAL5:
-                report[i] = KEY_SPACEBAR;
-                break;
-            default:
-                break;
-            }
-            break;
-        case OS_MAC:
-            switch (key) {
-            case KEY_INTERNATIONAL4:
-            case KEY_INTERNATIONAL5:
-                report[i] = KEY_SPACEBAR;
-                break;
-            case KEY_APPLICATION:
-                if (isMacMod()) {
-                    report[0] |= MOD_LEFTALT;
-                    memmove(report + i, report + i + 1, 7 - i);
-                    report[7] = 0;
-                    --i;
-                }
-                break;
-#ifdef WITH_HOS
-            case KEYPAD_ENTER:
-                report[i] = KEY_ENTER;
-                break;
-#endif
-            default:
-                break;
-            }
-            break;
-        case OS_104A:
-            switch (key) {
-            case KEY_LANG1:
-                report[i] = KEY_SPACEBAR;
-                report[0] |= MOD_LEFTSHIFT | MOD_LEFTCONTROL;
-                break;
-            case KEY_LANG2:
-                report[i] = KEY_BACKSPACE;
-                report[0] |= MOD_LEFTSHIFT | MOD_LEFTCONTROL;
-                break;
-            case KEY_INTERNATIONAL4:
-            case KEY_INTERNATIONAL5:
-                report[i] = KEY_SPACEBAR;
-                break;
-            default:
-                break;
-            }
-            break;
-        case OS_104B:
-            switch (key) {
-            case KEY_LANG1:
-            case KEY_LANG2:
-                report[i] = KEY_GRAVE_ACCENT;
-                report[0] |= MOD_LEFTALT;
-                break;
-            case KEY_INTERNATIONAL4:
-            case KEY_INTERNATIONAL5:
-                report[i] = KEY_SPACEBAR;
-                break;
-            default:
-                break;
-            }
-            break;
-        case OS_109A:
-            switch (key) {
-            case KEY_LANG1:
-                report[i] = KEY_INTERNATIONAL4;
-                report[0] |= MOD_LEFTSHIFT | MOD_LEFTCONTROL;
-                break;
-            case KEY_LANG2:
-                report[i] = KEY_INTERNATIONAL5;
-                report[0] |= MOD_LEFTSHIFT | MOD_LEFTCONTROL;
-                break;
-            default:
-                break;
-            }
-            break;
-        case OS_109B:
-            switch (key) {
-            case KEY_LANG1:
-            case KEY_LANG2:
-                report[i] = KEY_GRAVE_ACCENT;
-                break;
-            default:
-                break;
-            }
-            break;
-        case OS_ALT_SP:
-            switch (key) {
-            case KEY_LANG1:
-            case KEY_LANG2:
-                report[i] = KEY_SPACEBAR;
-                report[0] |= MOD_LEFTALT;
-                break;
-            default:
-                break;
-            }
-            break;
-        case OS_SHIFT_SP:
-            switch (key) {
-            case KEY_LANG1:
-            case KEY_LANG2:
-                report[i] = KEY_SPACEBAR;
-                report[0] |= MOD_LEFTSHIFT;
-                break;
-            default:
-                break;
-            }
-            break;
-        default:
-            break;
-        }
+
+        if (!key)
+            continue;
+        report[i] = 0;
+        key = getOSKey(key, report);
+        if (key)
+            report[n++] = key;
     }
 }
 
@@ -1023,97 +1409,228 @@ uint8_t processModKey(uint8_t key)
     return key;
 }
 
+/*
+ * Counts up the keys in matrix[] that differ from debounced[], and flips
+ * those that have reached the press or the release threshold.
+ */
+static void debounce(void)
+{
+    busy = 0;
+    for (int8_t i = 0; i < sizeof matrix; ++i) {
+        uint8_t changed = matrix[i] ^ debounced[i];
+        uint8_t carry = changed;
+        uint8_t match = changed;
+        uint8_t fresh = changed;
+
+        for (int8_t k = 0; k < COUNTER_BITS; ++k) {
+            uint8_t c = counters[k][i];
+            uint8_t n = (c ^ carry) & changed;
+            uint8_t t = (pressMasks[k] & ~debounced[i]) | (releaseMasks[k] & debounced[i]);
+
+            fresh &= ~c;
+            carry &= c;
+            match &= ~(n ^ t);
+            counters[k][i] = n;
+        }
+        fresh &= matrix[i];
+        if (fresh) {
+            for (int8_t b = 0; b < 8; ++b) {
+                if ((fresh & (1u << b)) && !isModifierKey(getKeyBase(8 * i + b)))
+                    startLatency(8 * i + b);
+            }
+        }
+        if (match) {
+            debounced[i] ^= match;
+            for (int8_t k = 0; k < COUNTER_BITS; ++k)
+                counters[k][i] &= ~match;
+        }
+        busy |= matrix[i] | debounced[i];
+    }
+}
+
+/*
+ * Debounces the keys reported by onPressed() and onScanned() since the last
+ * call, and queues the resulting key state if it has changed. A full queue
+ * keeps the newest state in its last entry. The modifier keys are debounced
+ * with the other keys, and then taken out of the keys as modifiers.
+ */
+void captureKeys(void)
+{
+    KeyState* newest = &state;
+    uint8_t keys[sizeof debounced];
+
+#if APP_MACHINE_VALUE != 0x4550
+    ++scanTick;
+#endif
+    maskGhosts();
+    for (int8_t row = 0; row < 8; ++row) {
+        uint16_t columns = rowColumns[row];
+
+        for (uint8_t column = 0; columns; ++column, columns >>= 1) {
+            if (columns & 1)
+                readKey(row, column);
+        }
+        rowColumns[row] = 0;
+    }
+    debounce();
+
+    for (int8_t i = 0; i < sizeof keys; ++i) {
+        uint8_t bits = debounced[i];
+
+        keys[i] = bits;
+        for (int8_t b = 0; bits; ++b, bits >>= 1) {
+            if ((bits & 1) && readModifier(8 * i + b))
+                keys[i] &= ~(1u << b);
+        }
+    }
+
+    if (stateCount)
+        newest = &states[(stateHead + stateCount - 1) % MAX_STATES];
+    if (newest->modifiers != modifiers || newest->modifiersExtra != modifiersExtra ||
+        memcmp(newest->keys, keys, sizeof keys))
+    {
+        if (stateCount < MAX_STATES)
+            newest = &states[(stateHead + stateCount++) % MAX_STATES];
+        newest->modifiers = modifiers;
+        newest->modifiersExtra = modifiersExtra;
+        memcpy(newest->keys, keys, sizeof keys);
+#if APP_MACHINE_VALUE != 0x4550
+        newest->tick = scanTick;
+#endif
+    }
+
+    memset(matrix, 0, sizeof matrix);
+    modifiers = 0;
+    modifiersExtra = 0;
+}
+
 int8_t makeReport(uint8_t* report)
 {
     int8_t xmit = XMIT_NONE;
-    int8_t at;
-    int8_t prev;
-
-    if (!detectGhost()) {
-        while (count < 8)
-            current[count++] = VOID_KEY;
-        memmove(keys[currentKey].keys, current + 2, 6);
-        current[0] = modifiers;
+    const uint8_t* keys = state.keys;
+#if APP_MACHINE_VALUE != 0x4550
+    uint8_t filtered[sizeof state.keys];
+#endif
+
+    captureKeys();
+#if APP_MACHINE_VALUE != 0x4550
+    stateTick = scanTick;
+#endif
+    if (stateCount) {
+        state = states[stateHead];
+        stateHead = (stateHead + 1) % MAX_STATES;
+        --stateCount;
+#if APP_MACHINE_VALUE != 0x4550
+        stateTick = state.tick;
+#endif
+    }
+    modifiers = state.modifiers;
+    modifiersExtra = state.modifiersExtra;
+#if APP_MACHINE_VALUE != 0x4550
+    memcpy(filtered, state.keys, sizeof filtered);
+    filterTapHold(filtered, &modifiers, &modifiersExtra);
+    keys = filtered;
+#endif
+
+    current[0] = modifiers;
 //        if (led & LED_SCROLL_LOCK)
 //            current[1] |= MOD_LEFTFN;
-        current[1] = modifiersExtra;
+    current[1] = modifiersExtra;
 #ifdef ENABLE_MOUSE
-        if (isMouseTouched())
-            current[1] |= MOD_PAD;
+    if (isMouseTouched())
+        current[1] |= MOD_PAD;
 #endif
 
-        if ((prefix_shift && isKanaMode(current)) || isZQMode(current)) {
-            current[0] |= prefix;
-            current[1] |= prefixExtra;
-            if (!(modifiersPrev & MOD_LEFTSHIFT) && (modifiers & MOD_LEFTSHIFT))
-                prefix ^= MOD_LEFTSHIFT;
-            if (!(modifiersPrev & MOD_RIGHTSHIFT) && (modifiers & MOD_RIGHTSHIFT))
-                prefix ^= MOD_RIGHTSHIFT;
-            if (!(modifiersExtraPrev & MOD_FN) && (modifiersExtra & MOD_FN))
-                prefixExtra ^= MOD_FN;
-            if (!(modifiersExtraPrev & MOD_FN2) && (modifiersExtra & MOD_FN2))
-                prefixExtra ^= MOD_FN2;
-        }
-        modifiersPrev = modifiers;
-        modifiersExtraPrev = modifiersExtra;
-
-        // Copy keys that exist in both keys[prev] and keys[at] for debouncing.
-        at = currentKey + DELAY_MAX + 2 - currentDelay;
-        if (DELAY_MAX + 1 < at)
-                at -= DELAY_MAX + 2;
-        prev = at + DELAY_MAX + 1;
-        if (DELAY_MAX + 1 < prev)
-                prev -= DELAY_MAX + 2;
-        count = 2;
-        for (int8_t i = 0; i < 6; ++i) {
-            uint8_t key = keys[at].keys[i];
-            if (memchr(keys[prev].keys, key, 6))
-                current[count++] = key;
+    if ((prefix_shift && isKanaMode(current)) || isZQMode(current)) {
+        current[0] |= prefix;
+        current[1] |= prefixExtra;
+        if (!(modifiersPrev & MOD_LEFTSHIFT) && (modifiers & MOD_LEFTSHIFT))
+            prefix ^= MOD_LEFTSHIFT;
+        if (!(modifiersPrev & MOD_RIGHTSHIFT) && (modifiers & MOD_RIGHTSHIFT))
+            prefix ^= MOD_RIGHTSHIFT;
+        if (!(modifiersExtraPrev & MOD_FN) && (modifiersExtra & MOD_FN))
+            prefixExtra ^= MOD_FN;
+        if (!(modifiersExtraPrev & MOD_FN2) && (modifiersExtra & MOD_FN2))
+            prefixExtra ^= MOD_FN2;
+    }
+    modifiersPrev = modifiers;
+    modifiersExtraPrev = modifiersExtra;
+
+    // Pick up to MAX_KEYS debounced keys in the order of their codes.
+    count = 2;
+    for (int8_t i = 0; i < sizeof state.keys && count < REPORT_SIZE; ++i) {
+        uint8_t bits = keys[i];
+
+        for (int8_t b = 0; bits && count < REPORT_SIZE; ++b, bits >>= 1) {
+            if (bits & 1)
+                current[count++] = 8 * i + b;
         }
-        while (count < 8)
-            current[count++] = VOID_KEY;
+    }
+    while (count < REPORT_SIZE)
+        current[count++] = VOID_KEY;
 
 #ifdef ENABLE_MOUSE
-        if (current[1] == MOD_PAD)
-            processMouseKeys(current, processed);
+    if (current[1] == MOD_PAD)
+        processMouseKeys(current, processed);
 #endif
 
-        if (memcmp(current, processed, 8)) {
-            if (memcmp(current + 2, processed + 2, 6) || current[2] == VOID_KEY || current[1] || (current[0] & MOD_SHIFT)) {
-                if (current[2] != VOID_KEY) {
-                    prefix = 0;
-                    prefixExtra = 0;
-                }
-                xmit = processKeys(current, processed, report);
-            } else if (processed[1] && !current[1] ||
-                     (processed[0] & MOD_LEFTSHIFT) && !(current[0] & MOD_LEFTSHIFT) ||
-                     (processed[0] & MOD_RIGHTSHIFT) && !(current[0] & MOD_RIGHTSHIFT))
-            {
-                /* empty */
-            } else
-                xmit = processKeys(current, processed, report);
-        }
-
-        processOSMode(report);
-    } else {
-        prev = currentKey + DELAY_MAX + 1;
-        if (DELAY_MAX + 1 < prev)
-                prev -= DELAY_MAX + 2;
-        memmove(keys[currentKey].keys, keys[prev].keys, 6);
+#if APP_MACHINE_VALUE != 0x4550
+    pollThumbs(current);
+#endif
+    if (memcmp(current, processed, REPORT_SIZE)) {
+        if (memcmp(current + 2, processed + 2, MAX_KEYS) || current[2] == VOID_KEY || current[1] || (current[0] & MOD_SHIFT)) {
+            if (current[2] != VOID_KEY) {
+                prefix = 0;
+                prefixExtra = 0;
+            }
+            xmit = processKeys(current, processed, report);
+        } else if (processed[1] && !current[1] ||
+                 (processed[0] & MOD_LEFTSHIFT) && !(current[0] & MOD_LEFTSHIFT) ||
+                 (processed[0] & MOD_RIGHTSHIFT) && !(current[0] & MOD_RIGHTSHIFT))
+        {
+            /* empty */
+        } else
+            xmit = processKeys(current, processed, report);
+    }
+#if APP_MACHINE_VALUE != 0x4550
+    // A key held back for a thumb key goes out once the window has passed.
+    if (xmit == XMIT_NONE && isThumbDue()) {
+        memset(report, 0, REPORT_SIZE);
+        xmit = processKeysKana(current, processed, report);
     }
+#endif
+    stopLatency(processed + 2);
+
+    processOSMode(report);
 
-    if (DELAY_MAX + 1 < ++currentKey)
-        currentKey = 0;
-    count = 2;
     modifiers = 0;
     modifiersExtra = 0;
 
     return xmit;
 }
 
+/*
+ * Returns non-zero while no key is held or being debounced and the last
+ * release has been processed, i.e., while scanning an empty matrix can only
+ * produce nothing. The caller can then stop scanning until a key goes down.
+ */
+int8_t isKeyboardIdle(void)
+{
+#ifdef ENABLE_MOUSE
+    if (isMouseTouched())
+        return 0;
+#endif
+    return !busy && !stateCount && !modifiersPrev && !modifiersExtraPrev &&
+           !processed[0] && !processed[1] && processed[2] == VOID_KEY && !isTapHoldBusy();
+}
+
 uint8_t controlLED(uint8_t report)
 {
+    uint8_t numLock = (led ^ report) & LED_NUM_LOCK;
+
     led = report;
+    if (numLock)
+        updateKeymap();
     report = controlKanaLED(report);
     report = controlZQLED(report);
 #ifdef ENABLE_MOUSE
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The MOD_FN and MOD_FN2 layers of the key matrix for the ZQ layout. Each
+ * entry lists up to three keys, modifiers first, sent for the key at
+ * [row][column] while FN or FN2 is held.
+ *
+ * This table is not compiled into the firmware. After editing it, run
+ * "make" in ../host to regenerate KeyboardFnPacked.h, which holds the same
+ * layers without the empty entries.
+ */
+
+#ifndef KEYBOARD_FN_H
+#define KEYBOARD_FN_H
+
+#include "Keyboard.h"
+
+static uint8_t const matrixFnZq[2][8][12][3] =
+{
+    /* KEY_FN */
+    {
+    {{00}, {KEY_F2}, {KEY_F3}, {KEY_F4}, {KEY_F5}, {KEY_F6}, {KEY_F7}, {KEY_F8}, {KEY_F9}, {KEY_F10}, {KEY_F11}, {00}},
+    {{KEY_ENTER}, {KEY_F1}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {KEY_F12}, {KEY_LEFTSHIFT, KEY_SEMICOLON}},
+    {{KEY_LEFTCONTROL, KEY_LEFTSHIFT, KEY_Z}, {KEY_ZQ_SOFTTAB2}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {KEY_DELETE}, {KEY_PRINTSCREEN}},
+    {{KEY_SLASH}, {00}, {KEY_ZQ_HOMEDIR}, {00}, {00}, {0}, {0}, {00}, {0}, {KEY_ZQ_SOFTTAB2}, {00}, {KEY_BACKSPACE}},
+    {{00}, {KEY_7}, {KEY_8}, {KEY_9}, {00}, {0}, {0}, {00}, {KEY_BACKSLASH}, {KEY_LEFTSHIFT, KEY_MINUS}, {KEY_EQUAL}, {00}},
+    {{KEY_0}, {KEY_4}, {KEY_5}, {KEY_6}, {00}, {KEY_END}, {KEY_HOME}, {KEY_MINUS}, {KEY_LEFTSHIFT, KEY_LEFT_BRACKET}, {KEY_LEFTSHIFT, KEY_9}, {KEY_LEFTSHIFT, KEY_0}, {KEY_LEFTSHIFT, KEY_RIGHT_BRACKET}},
+    {{KEY_PERIOD}, {KEY_1}, {KEY_2}, {KEY_3}, {KEY_GRAVE_ACCENT}, {00}, {00}, {00}, {KEY_LEFT_BRACKET}, {KEY_LEFTSHIFT, KEY_COMMA}, {KEY_LEFTSHIFT, KEY_PERIOD}, {KEY_RIGHT_BRACKET}},
+    {{KEY_LEFTSHIFT}, {KEY_RIGHTALT}, {KEY_LEFT_GUI}, {KEY_SPACEBAR}, {KEY_CAPS_LOCK}, {KEY_LEFTCONTROL}, {00}, {00}, {KEY_RIGHT_FN}, {KEY_LEFTALT}, {KEY_RIGHTALT}, {KEY_RIGHTSHIFT}}
+    },
+
+    /* KEY_FN2 */
+    {
+    {{00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}, {00}},
+    {{00}, {00}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {00}, {00}},
+    {{00}, {00}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {00}, {00}},
+    {{00}, {00}, {00}, {00}, {00}, {0}, {0}, {00}, {00}, {00}, {00}, {00}},
+    {{00}, {00}, {00}, {00}, {00}, {0}, {0}, {00}, {00}, {00}, {00}, {00}},
+    {{00}, {00}, {00}, {00}, {00}, {KEY_PRINTSCREEN}, {KEY_SCROLL_LOCK}, {KEY_LEFTARROW}, {KEY_DOWNARROW}, {KEY_UPARROW}, {KEY_RIGHTARROW}, {00}},
+    {{00}, {00}, {00}, {00}, {00}, {KEY_PAUSE}, {KEY_INSERT}, {00}, {00}, {00}, {00}, {KEY_LEFTSHIFT, KEY_INSERT}},
+    {{00}, {KEY_RIGHTALT}, {KEY_LEFTCONTROL}, {KEY_BACKSPACE}, {KEY_CAPS_LOCK}, {KEY_LEFT_GUI}, {00}, {00}, {00}, {KEY_LEFTALT}, {KEY_RIGHTALT}, {00}}
+    },
+};
+
+#endif  // #ifndef KEYBOARD_FN_H
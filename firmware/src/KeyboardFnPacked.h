@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Generated from KeyboardFn.h by firmware/host/mkfn; do not edit.
+ *
+ * matrixFnZq[2][8][12][3]: 576 bytes, packed: 273 bytes
+ */
+
+#ifndef KEYBOARD_FN_PACKED_H
+#define KEYBOARD_FN_PACKED_H
+
+#include <stdint.h>
+
+static uint16_t const fnColumns[2][8] =
+{
+    {0x7fe, 0xc03, 0xc03, 0xa05, 0x70e, 0xfef, 0xf1f, 0xf3f},
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x7e0, 0x860, 0x63e},
+};
+
+static uint8_t const fnOffsets[2][8] =
+{
+    {1, 11, 15, 19, 23, 29, 40, 49},
+    {59, 59, 59, 59, 59, 59, 65, 68},
+};
+
+static uint8_t const fnKeys[75][3] =
+{
+    {0x00, 0x00, 0x00},
+    {0x3b, 0x00, 0x00},     // [0][0][1]
+    {0x3c, 0x00, 0x00},     // [0][0][2]
+    {0x3d, 0x00, 0x00},     // [0][0][3]
+    {0x3e, 0x00, 0x00},     // [0][0][4]
+    {0x3f, 0x00, 0x00},     // [0][0][5]
+    {0x40, 0x00, 0x00},     // [0][0][6]
+    {0x41, 0x00, 0x00},     // [0][0][7]
+    {0x42, 0x00, 0x00},     // [0][0][8]
+    {0x43, 0x00, 0x00},     // [0][0][9]
+    {0x44, 0x00, 0x00},     // [0][0][10]
+    {0x28, 0x00, 0x00},     // [0][1][0]
+    {0x3a, 0x00, 0x00},     // [0][1][1]
+    {0x45, 0x00, 0x00},     // [0][1][10]
+    {0xe1, 0x33, 0x00},     // [0][1][11]
+    {0xe0, 0xe1, 0x1d},     // [0][2][0]
+    {0xf6, 0x00, 0x00},     // [0][2][1]
+    {0x4c, 0x00, 0x00},     // [0][2][10]
+    {0x46, 0x00, 0x00},     // [0][2][11]
+    {0x38, 0x00, 0x00},     // [0][3][0]
+    {0xf8, 0x00, 0x00},     // [0][3][2]
+    {0xf6, 0x00, 0x00},     // [0][3][9]
+    {0x2a, 0x00, 0x00},     // [0][3][11]
+    {0x24, 0x00, 0x00},     // [0][4][1]
+    {0x25, 0x00, 0x00},     // [0][4][2]
+    {0x26, 0x00, 0x00},     // [0][4][3]
+    {0x31, 0x00, 0x00},     // [0][4][8]
+    {0xe1, 0x2d, 0x00},     // [0][4][9]
+    {0x2e, 0x00, 0x00},     // [0][4][10]
+    {0x27, 0x00, 0x00},     // [0][5][0]
+    {0x21, 0x00, 0x00},     // [0][5][1]
+    {0x22, 0x00, 0x00},     // [0][5][2]
+    {0x23, 0x00, 0x00},     // [0][5][3]
+    {0x4d, 0x00, 0x00},     // [0][5][5]
+    {0x4a, 0x00, 0x00},     // [0][5][6]
+    {0x2d, 0x00, 0x00},     // [0][5][7]
+    {0xe1, 0x2f, 0x00},     // [0][5][8]
+    {0xe1, 0x26, 0x00},     // [0][5][9]
+    {0xe1, 0x27, 0x00},     // [0][5][10]
+    {0xe1, 0x30, 0x00},     // [0][5][11]
+    {0x37, 0x00, 0x00},     // [0][6][0]
+    {0x1e, 0x00, 0x00},     // [0][6][1]
+    {0x1f, 0x00, 0x00},     // [0][6][2]
+    {0x20, 0x00, 0x00},     // [0][6][3]
+    {0x35, 0x00, 0x00},     // [0][6][4]
+    {0x2f, 0x00, 0x00},     // [0][6][8]
+    {0xe1, 0x36, 0x00},     // [0][6][9]
+    {0xe1, 0x37, 0x00},     // [0][6][10]
+    {0x30, 0x00, 0x00},     // [0][6][11]
+    {0xe1, 0x00, 0x00},     // [0][7][0]
+    {0xe6, 0x00, 0x00},     // [0][7][1]
+    {0xe3, 0x00, 0x00},     // [0][7][2]
+    {0x2c, 0x00, 0x00},     // [0][7][3]
+    {0x39, 0x00, 0x00},     // [0][7][4]
+    {0xe0, 0x00, 0x00},     // [0][7][5]
+    {0xf1, 0x00, 0x00},     // [0][7][8]
+    {0xe2, 0x00, 0x00},     // [0][7][9]
+    {0xe6, 0x00, 0x00},     // [0][7][10]
+    {0xe5, 0x00, 0x00},     // [0][7][11]
+    {0x46, 0x00, 0x00},     // [1][5][5]
+    {0x47, 0x00, 0x00},     // [1][5][6]
+    {0x50, 0x00, 0x00},     // [1][5][7]
+    {0x51, 0x00, 0x00},     // [1][5][8]
+    {0x52, 0x00, 0x00},     // [1][5][9]
+    {0x4f, 0x00, 0x00},     // [1][5][10]
+    {0x48, 0x00, 0x00},     // [1][6][5]
+    {0x49, 0x00, 0x00},     // [1][6][6]
+    {0xe1, 0x49, 0x00},     // [1][6][11]
+    {0xe6, 0x00, 0x00},     // [1][7][1]
+    {0xe0, 0x00, 0x00},     // [1][7][2]
+    {0x2a, 0x00, 0x00},     // [1][7][3]
+    {0x39, 0x00, 0x00},     // [1][7][4]
+    {0xe3, 0x00, 0x00},     // [1][7][5]
+    {0xe2, 0x00, 0x00},     // [1][7][9]
+    {0xe6, 0x00, 0x00},     // [1][7][10]
+};
+
+#endif  // #ifndef KEYBOARD_FN_PACKED_H
@@ -21,14 +21,41 @@
 
 #define MAX_KANA_KEY_NAME    6
 
-#define ENABLE_MTYPE
-#define ENABLE_STICKNEY
-
 static uint8_t const kanaKeys[KANA_MAX + 1][MAX_KANA_KEY_NAME] =
 {
     {KEY_T, KEY_R, KEY_O, KEY_N, KEY_ENTER},
+    {KEY_N, KEY_I, KEY_C, KEY_O, KEY_L, KEY_A},
+    {KEY_M, KEY_T, KEY_Y, KEY_P, KEY_E, KEY_ENTER},
+    {KEY_R, KEY_O, KEY_M, KEY_A, KEY_ENTER},
+    {KEY_S, KEY_T, KEY_I, KEY_C, KEY_K, KEY_ENTER},
+    {KEY_X, KEY_6, KEY_0, KEY_0, KEY_4, KEY_ENTER},
+};
+
+// The unshifted, left shift, and right shift planes of each kana layout
+static uint8_t const kanaLayouts[KANA_MAX + 1][3] =
+{
+    {LAYOUT_TRON, LAYOUT_TRON_LEFT, LAYOUT_TRON_RIGHT},
+    {LAYOUT_NICOLA, LAYOUT_NICOLA_LEFT, LAYOUT_NICOLA_RIGHT},
+    {LAYOUT_MTYPE, LAYOUT_MTYPE_SHIFT, LAYOUT_MTYPE_SHIFT},
+    {LAYOUT_NONE, LAYOUT_NONE, LAYOUT_NONE},
+    {LAYOUT_STICKNEY, LAYOUT_STICKNEY_SHIFT, LAYOUT_STICKNEY_SHIFT},
+    {LAYOUT_X6004, LAYOUT_X6004_SHIFT, LAYOUT_X6004_SHIFT},
+};
+
+#if APP_MACHINE_VALUE != 0x4550
+#define MAX_THUMB_KEY_NAME  5
+
+static uint8_t const thumbKeyNames[THUMB_MAX + 1][MAX_THUMB_KEY_NAME] =
+{
+    {KEY_T, KEY_5, KEY_0, KEY_ENTER},
+    {KEY_T, KEY_7, KEY_5, KEY_ENTER},
+    {KEY_T, KEY_1, KEY_0, KEY_0, KEY_ENTER},
+    {KEY_T, KEY_0, KEY_ENTER},
 };
 
+static uint8_t const thumbWindows[THUMB_MAX + 1] = { 50, 75, 100, 0 };
+#endif
+
 #define MAX_LED_KEY_NAME    4
 
 static uint8_t const ledKeyNames[LED_MAX + 1][MAX_LED_KEY_NAME] =
@@ -50,49 +77,48 @@ static uint8_t const imeKeyNames[IME_MAX + 1][MAX_IME_KEY_NAME] =
     {KEY_A, KEY_T, KEY_O, KEY_K, KEY_ENTER},
     {KEY_G, KEY_O, KEY_O, KEY_G, KEY_ENTER},
     {KEY_A, KEY_P, KEY_P, KEY_L, KEY_ENTER},
+#if APP_MACHINE_VALUE != 0x4550
+    {KEY_K, KEY_A, KEY_N, KEY_A, KEY_ENTER},
+#endif
 };
 
-static uint8_t const consonantSet[][2] =
-{
-    {0},
-    {KEY_K},
-    {KEY_S},
-    {KEY_T},
-    {KEY_N},
-    {KEY_H},
-    {KEY_M},
-    {KEY_Y},
-    {KEY_R},
-    {KEY_W},
-    {KEY_P},
-    {KEY_G},
-    {KEY_Z},
-    {KEY_D},
-    {KEY_B},
-    {KEY_X},
-    {KEY_X, KEY_K},
-    {KEY_X, KEY_T},
-    {KEY_X, KEY_Y},
-    {KEY_X, KEY_W},
-    {KEY_W, KEY_Y},
-    {KEY_V},
-    {KEY_L},
-};
+#define CV(c0, c1, v)   {(c0) ? (c0) : (v), (c0) ? ((c1) ? (c1) : (v)) : 0, (c0) && (c1) ? (v) : 0}
 
-static uint8_t const vowelSet[] =
-{
-    0,
-    KEY_A,
-    KEY_I,
-    KEY_U,
-    KEY_E,
-    KEY_O,
-    KEY_Y
-};
+// A consonant followed by each vowel
+#define CONSONANT(c0, c1) \
+    CV(c0, c1, 0), CV(c0, c1, KEY_A), CV(c0, c1, KEY_I), CV(c0, c1, KEY_U), \
+    CV(c0, c1, KEY_E), CV(c0, c1, KEY_O), CV(c0, c1, KEY_Y)
 
-#ifdef ENABLE_MTYPE
-static uint8_t const mtypeSet[][3] =
-{
+//
+// ROMA_NONE - ROMA_BANG, which type the same keys whatever the IME is
+//
+static uint8_t const romaSet[ROMA_BANG + 1][3] =
+{
+    CONSONANT(0, 0),
+    CONSONANT(KEY_K, 0),
+    CONSONANT(KEY_S, 0),
+    CONSONANT(KEY_T, 0),
+    CONSONANT(KEY_N, 0),
+    CONSONANT(KEY_H, 0),
+    CONSONANT(KEY_M, 0),
+    CONSONANT(KEY_Y, 0),
+    CONSONANT(KEY_R, 0),
+    CONSONANT(KEY_W, 0),
+    CONSONANT(KEY_P, 0),
+    CONSONANT(KEY_G, 0),
+    CONSONANT(KEY_Z, 0),
+    CONSONANT(KEY_D, 0),
+    CONSONANT(KEY_B, 0),
+    CONSONANT(KEY_X, 0),
+    CONSONANT(KEY_X, KEY_K),
+    CONSONANT(KEY_X, KEY_T),
+    CONSONANT(KEY_X, KEY_Y),
+    CONSONANT(KEY_X, KEY_W),
+    CONSONANT(KEY_W, KEY_Y),
+    CONSONANT(KEY_V, 0),
+    CONSONANT(KEY_L, 0),
+
+    // M-type
     {KEY_A, KEY_N, KEY_N},
     {KEY_A, KEY_K, KEY_U},
     {KEY_A, KEY_T, KEY_U},
@@ -115,12 +141,13 @@ static uint8_t const mtypeSet[][3] =
     {KEY_F},
     {KEY_J},
     {KEY_Q},
-};
-#endif
 
-// ROMA_NN - ROMA_BANG
-static uint8_t const commonSet[][2] =
-{
+    // ROMA_Q + 1 - ROMA_NN - 1
+    {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0},
+    {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0},
+    {0},
+
+    // Common
     {KEY_N, KEY_N},
     {KEY_MINUS},
     {KEY_DAKUTEN},
@@ -220,157 +247,69 @@ static uint8_t const appleSet[][3] =
     {KEY_LEFTSHIFT, KEY_GRAVE_ACCENT},
 };
 
-#ifdef ENABLE_STICKNEY
-//
-// Stickney Next
-//
-static uint8_t const matrixStickney[7][12] =
-{
-    {KANA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {KANA_RCB, KANA_HO, 0, 0, 0, 0, 0, 0, 0, 0, 0, KANA_KUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, KANA_TOUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, KANA_DAKUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, KANA_WO, 0, 0, 0, 0, 0, 0, 0, 0, KANA_CHOUON},
-};
-
-static uint8_t const matrixStickneyShift[7][12] =
-{
-    {KANA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {KANA_RCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, KANA_KUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, KANA_NAKAGURO},
-    {0, 0, 0, KANA_SO, 0, 0, 0, 0, 0, 0, 0, KANA_HANDAKU},
-    {0, 0, KANA_SE, KANA_HE, KANA_KE, 0, 0, 0, KANA_ME, KANA_NU, KANA_RO, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, KANA_MU, 0, 0, 0},
-};
-#endif
-
-//
-// TRON
-//
-static uint8_t const matrixTron[7][12] =
-{
-    {ROMA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RA, ROMA_RU, ROMA_KO, ROMA_HA, ROMA_XYO, 0, 0, ROMA_KI, ROMA_NO, ROMA_KU, ROMA_A, ROMA_RE},
-    {ROMA_TA, ROMA_TO, ROMA_KA, ROMA_TE, ROMA_MO, 0, 0, ROMA_WO, ROMA_I, ROMA_U, ROMA_SI, ROMA_NN},
-    {ROMA_MA, ROMA_RI, ROMA_NI, ROMA_SA, ROMA_NA, 0, 0, ROMA_SU, ROMA_TU, ROMA_TOUTEN, ROMA_KUTEN, ROMA_XTU},
-};
-
-static uint8_t const matrixTronLeft[7][12] =
-{
-    {ROMA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_SANTEN, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_HI, ROMA_SO, ROMA_NAKAGURO, ROMA_XYA, ROMA_HO, 0, 0, ROMA_GI, ROMA_GE, ROMA_GU, ROMA_QUESTION, ROMA_WYI},
-    {ROMA_NU, ROMA_NE, ROMA_XYU, ROMA_YO, ROMA_HU, 0, 0, ROMA_DAKUTEN, ROMA_DI, ROMA_VU, ROMA_ZI, ROMA_WYE},
-    {ROMA_XE, ROMA_XO, ROMA_SE, ROMA_YU, ROMA_HE, 0, 0, ROMA_ZU, ROMA_DU, ROMA_COMMA, ROMA_PERIOD, ROMA_XWA},
-};
+#if APP_MACHINE_VALUE != 0x4550
 
-static uint8_t const matrixTronRight[7][12] =
+// The nearest kana input for ROMA_LCB - ROMA_NAMI
+static uint8_t const kanaInputSet[][3] =
 {
-    {ROMA_LWCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RWCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_BI, ROMA_ZO, ROMA_GO, ROMA_BA, ROMA_BO, 0, 0, ROMA_E, ROMA_KE, ROMA_ME, ROMA_MU, ROMA_RO},
-    {ROMA_DA, ROMA_DO, ROMA_GA, ROMA_DE, ROMA_BU, 0, 0, ROMA_O, ROMA_TI, ROMA_CHOUON, ROMA_MI, ROMA_YA},
-    {ROMA_XKA, ROMA_XKE, ROMA_ZE, ROMA_ZA, ROMA_BE, 0, 0, ROMA_WA, ROMA_XI, ROMA_XA, ROMA_HANDAKU, ROMA_XU},
-};
-
-//
-// Nicola
-//
-static uint8_t const matrixNicola[7][12] =
-{
-    {ROMA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_DAKUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_TOUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_KUTEN, ROMA_KA, ROMA_TA, ROMA_KO, ROMA_SA, 0, 0, ROMA_RA, ROMA_TI, ROMA_KU, ROMA_TU, ROMA_TOUTEN},
-    {ROMA_U, ROMA_SI, ROMA_TE, ROMA_KE, ROMA_SE, 0, 0, ROMA_HA, ROMA_TO, ROMA_KI, ROMA_I, ROMA_NN},
-    {ROMA_KUTEN, ROMA_HI, ROMA_SU, ROMA_HU, ROMA_HE, 0, 0, ROMA_ME, ROMA_SO, ROMA_NE, ROMA_HO, ROMA_NAKAGURO},
+    {KEY_LEFTSHIFT, KEY_RIGHT_BRACKET},
+    {KEY_LEFTSHIFT, KEY_NON_US_HASH},
+    {KEY_LEFTSHIFT, KEY_RIGHT_BRACKET},
+    {KEY_LEFTSHIFT, KEY_NON_US_HASH},
+    {KEY_LEFTSHIFT, KEY_RIGHT_BRACKET},
+    {KEY_LEFTSHIFT, KEY_NON_US_HASH},
+    {KEY_LEFTSHIFT, KEY_SLASH},
+    {KEY_LEFTSHIFT, KEY_SLASH},
+    {KEY_LEFTSHIFT, KEY_SLASH, KEY_SLASH},
+    {KEY_LEFTSHIFT, KEY_COMMA},
+    {KEY_LEFTSHIFT, KEY_PERIOD},
+    {KEY_INTERNATIONAL3},
 };
 
-static uint8_t const matrixNicolaLeft[7][12] =
-{
-    {ROMA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_DAKUTEN},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RCB, ROMA_QUESTION, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_TOUTEN},
-    {0, ROMA_SLASH, ROMA_NAMI, ROMA_LCB, ROMA_RCB, 0, 0, ROMA_LSB, ROMA_RSB, 0, 0, 0},
-    {ROMA_XA, ROMA_E, ROMA_RI, ROMA_XYA, ROMA_RE, 0, 0, ROMA_PA, ROMA_DI, ROMA_GU, ROMA_DU, ROMA_PI},
-    {ROMA_WO, ROMA_A, ROMA_NA, ROMA_XYU, ROMA_MO, 0, 0, ROMA_BA, ROMA_DO, ROMA_GI, ROMA_PO, ROMA_NN},
-    {ROMA_XU, ROMA_CHOUON, ROMA_RO, ROMA_YA, ROMA_XI, 0, 0, ROMA_PU, ROMA_ZO, ROMA_PE, ROMA_BO, ROMA_NAKAGURO},
-};
+#define SMALL(k)        {(k) ? KEY_LEFTSHIFT : 0, k}
+#define VOICED(k, m)    {k, (k) ? (m) : 0}
 
-static uint8_t const matrixNicolaRight[7][12] =
-{
-    {ROMA_LWCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_HANDAKU},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RWCB, ROMA_QUESTION, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_TOUTEN},
-    {0, ROMA_SLASH, ROMA_NAMI, ROMA_LCB, ROMA_RCB, 0, 0, ROMA_LSB, ROMA_RSB, 0, 0, 0},
-    {ROMA_KUTEN, ROMA_GA, ROMA_DA, ROMA_GO, ROMA_ZA, 0, 0, ROMA_YO, ROMA_NI, ROMA_RU, ROMA_MA, ROMA_XE},
-    {ROMA_VU, ROMA_ZI, ROMA_DE, ROMA_GE, ROMA_ZE, 0, 0, ROMA_MI, ROMA_O, ROMA_NO, ROMA_XYO, ROMA_XTU},
-    {ROMA_KUTEN, ROMA_BI, ROMA_ZU, ROMA_BU, ROMA_BE, 0, 0, ROMA_NU, ROMA_YU, ROMA_MU, ROMA_WA, ROMA_XO},
-};
+// The kana from A to O of a row; the consonant alone and its Y column have none
+#define KANA_ROW(a, i, u, e, o) \
+    {0}, {a}, {i}, {u}, {e}, {o}, {0}
+#define SMALL_ROW(a, i, u, e, o) \
+    {0}, SMALL(a), SMALL(i), SMALL(u), SMALL(e), SMALL(o), {0}
+#define VOICED_ROW(a, i, u, e, o, m) \
+    {0}, VOICED(a, m), VOICED(i, m), VOICED(u, m), VOICED(e, m), VOICED(o, m), {0}
 
-#ifdef ENABLE_MTYPE
 //
-// M type
+// ROMA_NONE - ROMA_LO on the JIS kana keys. A dakuon is typed with the
+// dakuten key after the kana, which the IME puts together by itself.
 //
-static uint8_t const matrixMtype[7][12] =
-{
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_Q, ROMA_L, ROMA_J, ROMA_F, ROMA_C, 0, 0, ROMA_M, ROMA_Y, ROMA_R, ROMA_W, ROMA_P},
-    {ROMA_E, ROMA_U, ROMA_I, ROMA_A, ROMA_O, 0, 0, ROMA_K, ROMA_S, ROMA_T, ROMA_N, ROMA_H},
-    {ROMA_EI, ROMA_X, ROMA_V, ROMA_AI, ROMA_OU, 0, 0, ROMA_G, ROMA_Z, ROMA_D, ROMA_TOUTEN, ROMA_B},
+static uint8_t const kanaSet[ROMA_ANN][2] =
+{
+    KANA_ROW(KEY_3, KEY_E, KEY_4, KEY_5, KEY_6),
+    KANA_ROW(KEY_T, KEY_G, KEY_H, KEY_QUOTE, KEY_B),
+    KANA_ROW(KEY_X, KEY_D, KEY_R, KEY_P, KEY_C),
+    KANA_ROW(KEY_Q, KEY_A, KEY_Z, KEY_W, KEY_S),
+    KANA_ROW(KEY_U, KEY_I, KEY_1, KEY_COMMA, KEY_K),
+    KANA_ROW(KEY_F, KEY_V, KEY_2, KEY_EQUAL, KEY_MINUS),
+    KANA_ROW(KEY_J, KEY_N, KEY_NON_US_HASH, KEY_SLASH, KEY_M),
+    KANA_ROW(KEY_7, 0, KEY_8, 0, KEY_9),
+    KANA_ROW(KEY_O, KEY_L, KEY_PERIOD, KEY_SEMICOLON, KEY_INTERNATIONAL1),
+    {0}, {KEY_0}, {0}, {0}, {0}, SMALL(KEY_0), {0},
+    VOICED_ROW(KEY_F, KEY_V, KEY_2, KEY_EQUAL, KEY_MINUS, KEY_RIGHT_BRACKET),
+    VOICED_ROW(KEY_T, KEY_G, KEY_H, KEY_QUOTE, KEY_B, KEY_LEFT_BRACKET),
+    VOICED_ROW(KEY_X, KEY_D, KEY_R, KEY_P, KEY_C, KEY_LEFT_BRACKET),
+    VOICED_ROW(KEY_Q, KEY_A, KEY_Z, KEY_W, KEY_S, KEY_LEFT_BRACKET),
+    VOICED_ROW(KEY_F, KEY_V, KEY_2, KEY_EQUAL, KEY_MINUS, KEY_LEFT_BRACKET),
+    SMALL_ROW(KEY_3, KEY_E, KEY_4, KEY_5, KEY_6),
+    KANA_ROW(0, 0, 0, 0, 0),
+    SMALL_ROW(0, 0, KEY_Z, 0, 0),
+    SMALL_ROW(KEY_7, 0, KEY_8, 0, KEY_9),
+    KANA_ROW(0, 0, 0, 0, 0),
+    KANA_ROW(0, 0, 0, 0, 0),
+    VOICED_ROW(0, 0, KEY_4, 0, 0, KEY_LEFT_BRACKET),
+    SMALL_ROW(KEY_3, KEY_E, KEY_4, KEY_5, KEY_6),
 };
 
-static uint8_t const matrixMtypeShift[7][12] =
-{
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_EKI, ROMA_UKU, ROMA_IKU, ROMA_AKU, ROMA_OKU, 0, 0, ROMA_MY, ROMA_XTU, ROMA_RY, ROMA_NN, ROMA_PY},
-    {ROMA_ENN, ROMA_UNN, ROMA_INN, ROMA_ANN, ROMA_ONN, 0, 0, ROMA_KY, ROMA_SY, ROMA_TY, ROMA_NY, ROMA_HY},
-    {ROMA_ETU, ROMA_UTU, ROMA_ITU, ROMA_ATU, ROMA_OTU, 0, 0, ROMA_GY, ROMA_ZY, ROMA_DY, ROMA_KUTEN, ROMA_BY},
-};
 #endif
 
-//
-// JIS X 6004
-//
-static uint8_t const matrixX6004[7][12] =
-{
-    {ROMA_LCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_TI},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_NA},
-    {ROMA_SO, ROMA_KE, ROMA_SE, ROMA_TE, ROMA_XYO, 0, 0, ROMA_TU, ROMA_NN, ROMA_NO, ROMA_WO, ROMA_RI},
-    {ROMA_HA, ROMA_KA, ROMA_SI, ROMA_TO, ROMA_TA, 0, 0, ROMA_KU, ROMA_U, ROMA_I, ROMA_DAKUTEN, ROMA_KI},
-    {ROMA_SU, ROMA_KO, ROMA_NI, ROMA_SA, ROMA_A, 0, 0, ROMA_XTU, ROMA_RU, ROMA_TOUTEN, ROMA_KUTEN, ROMA_RE},
-};
-
-static uint8_t const matrixX6004Shift[7][12] =
-{
-    {ROMA_LWCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {ROMA_RWCB, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_LCB},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ROMA_RCB},
-    {ROMA_XA, ROMA_HANDAKU, ROMA_HO, ROMA_HU, ROMA_ME, 0, 0, ROMA_HI, ROMA_E, ROMA_MI, ROMA_YA, ROMA_NU},
-    {ROMA_XI, ROMA_HE, ROMA_RA, ROMA_XYU, ROMA_YO, 0, 0, ROMA_MA, ROMA_O, ROMA_MO, ROMA_WA, ROMA_YU},
-    {ROMA_XU, ROMA_XE, ROMA_XO, ROMA_NE, ROMA_XYA, 0, 0, ROMA_MU, ROMA_RO, ROMA_NAKAGURO, ROMA_CHOUON, ROMA_QUESTION},
-};
-
 static uint8_t const dakuonFrom[] = { KEY_K, KEY_S, KEY_T, KEY_H };
 static uint8_t const dakuonTo[] = { KEY_G, KEY_Z, KEY_D, KEY_B };
 
@@ -384,6 +323,36 @@ static uint8_t sent[3];
 static uint8_t last[3];
 static uint8_t lastMod;
 
+#if APP_MACHINE_VALUE != 0x4550
+/*
+ * The NICOLA thumb shift state. A character key pressed with no thumb key
+ * held is held back for up to the window, and a thumb key pressed within it
+ * shifts the key held back. If another character key follows, the thumb key
+ * goes with whichever of the two character keys is closer to it in time.
+ * Times are stateTick values, i.e., counted in scans.
+ */
+typedef struct ThumbShift {
+    uint8_t pending;        // The character key held back
+    uint8_t pendingTick;
+    uint8_t thumb;          // The thumb key pressed after pending, if any
+    uint8_t thumbTick;
+    uint8_t held;           // The thumb keys held
+    uint8_t used;           // The thumb keys held that shifted a key pressed before them
+} ThumbShift;
+
+static uint8_t thumb;
+static ThumbShift shift = { VOID_KEY };
+#endif
+
+#define PLANE_AUTO      3   // The plane is chosen by the modifiers
+#define HELD_BACK       4   // Set in the plane of the key held back
+
+/*
+ * The keys typed for ROMA_LCB - ROMA_NAMI with the current IME and base
+ * layout. Rebuilt by updateRomaji() whenever either of them changes.
+ */
+static uint8_t imeSet[ROMA_NAMI - ROMA_LCB + 1][3];
+
 void loadKanaSettings(void)
 {
     mode = ReadNvram(EEPROM_KANA);
@@ -397,6 +366,13 @@ void loadKanaSettings(void)
     ime = ReadNvram(EEPROM_IME);
     if (IME_MAX < ime)
         ime = 0;
+    updateRomaji();
+
+#if APP_MACHINE_VALUE != 0x4550
+    thumb = ReadNvram(EEPROM_THUMB);
+    if (THUMB_MAX < thumb)
+        thumb = 0;
+#endif
 }
 
 void emitLEDName(void)
@@ -427,6 +403,23 @@ void switchKana(void)
     emitKanaName();
 }
 
+#if APP_MACHINE_VALUE != 0x4550
+void emitThumbName(void)
+{
+    emitStringN(thumbKeyNames[thumb], MAX_THUMB_KEY_NAME);
+}
+
+void switchThumb(void)
+{
+    ++thumb;
+    if (THUMB_MAX < thumb)
+        thumb = 0;
+    WriteNvram(EEPROM_THUMB, thumb);
+    shift.pending = VOID_KEY;
+    emitThumbName();
+}
+#endif
+
 void emitIMEName(void)
 {
     emitStringN(imeKeyNames[ime], MAX_IME_KEY_NAME);
@@ -438,83 +431,258 @@ void switchIME(void)
     if (IME_MAX < ime)
         ime = 0;
     WriteNvram(EEPROM_IME, ime);
+    updateRomaji();
     emitIMEName();
 }
 
-static void processRomaji(uint8_t roma, uint8_t a[])
+// Returns the key typed for key in the IME symbols on the JIS layout.
+static uint8_t getJPKey(uint8_t key)
 {
-    uint8_t const* c;
-    uint8_t i;
+    switch (key) {
+    case KEY_LEFT_BRACKET:
+        return KEY_RIGHT_BRACKET;
+    case KEY_RIGHT_BRACKET:
+        return KEY_NON_US_HASH;
+    case KEY_GRAVE_ACCENT:
+        return KEY_EQUAL;
+    case KEY_9:
+        return KEY_8;
+    case KEY_0:
+        return KEY_9;
+    default:
+        return key;
+    }
+}
 
-    if (roma < ROMA_ANN) {
-        c = consonantSet[roma / 7];
-        for (i = 0; i < 2 && c[i]; ++i)
-            a[i] = c[i];
-        a[i++] = vowelSet[roma % 7];
-        while (i < 3)
-            a[i++] = 0;
+void updateRomaji(void)
+{
+    uint8_t const (*set)[3];
+
+    switch (ime) {
+    case IME_GOOGLE:
+        set = googleSet;
+        break;
+    case IME_APPLE:
+        set = appleSet;
+        break;
+#if APP_MACHINE_VALUE != 0x4550
+    case IME_KANA:
+        memcpy(imeSet, kanaInputSet, sizeof imeSet);
         return;
+#endif
+    case IME_ATOK:
+        set = atokSet;
+        break;
+    case IME_MS:
+    default:
+        set = msSet;
+        break;
     }
-#ifdef ENABLE_MTYPE
-    if (ROMA_ANN <= roma && roma <= ROMA_Q) {
-        memcpy(a, mtypeSet[roma - ROMA_ANN], 3);
-        return;
+    memcpy(imeSet, set, sizeof imeSet);
+    if (isJP()) {
+        for (uint8_t i = 0; i < ROMA_NAMI - ROMA_LCB + 1; ++i) {
+            for (uint8_t j = 0; j < 3; ++j)
+                imeSet[i][j] = getJPKey(imeSet[i][j]);
+        }
+    }
+}
+
+#if APP_MACHINE_VALUE != 0x4550
+/*
+ * Sets in a[] the JIS kana keys that type roma with the IME in kana input
+ * mode, and returns a[0], which is 0 if roma has no kana key of its own.
+ */
+static uint8_t getKanaKeys(uint8_t roma, uint8_t a[])
+{
+    memset(a, 0, 3);
+    if (roma < ROMA_ANN) {
+        memcpy(a, kanaSet[roma], 2);
+        return a[0];
     }
+    switch (roma) {
+    case ROMA_NN:
+        a[0] = KEY_Y;
+        break;
+    case ROMA_CHOUON:
+        a[0] = KEY_INTERNATIONAL3;
+        break;
+    case ROMA_DAKUTEN:
+        a[0] = KEY_LEFT_BRACKET;
+        break;
+    case ROMA_HANDAKU:
+        a[0] = KEY_RIGHT_BRACKET;
+        break;
+    case ROMA_TOUTEN:
+        a[0] = KEY_LEFTSHIFT;
+        a[1] = KEY_COMMA;
+        break;
+    case ROMA_KUTEN:
+        a[0] = KEY_LEFTSHIFT;
+        a[1] = KEY_PERIOD;
+        break;
+    default:
+        break;
+    }
+    return a[0];
+}
+#endif
+
+static void processRomaji(uint8_t roma, uint8_t a[])
+{
+#if APP_MACHINE_VALUE != 0x4550
+    // M type is typed by romaji, so it is left as it is.
+    if (ime == IME_KANA && mode != KANA_MTYPE && getKanaKeys(roma, a))
+        return;
 #endif
-    if (ROMA_NN <= roma && roma <= ROMA_BANG) {
-        memcpy(a, commonSet[roma - ROMA_NN], 2);
-        a[2] = 0;
+    if (roma <= ROMA_BANG)
+        memcpy(a, romaSet[roma], 3);
+    else if (ROMA_LCB <= roma && roma <= ROMA_NAMI)
+        memcpy(a, imeSet[roma - ROMA_LCB], 3);
+    else
+        memset(a, 0, 3);
+}
+
+static uint8_t queued;          // Keys of this scan queued in the macro
+static uint8_t queuedMod;       // Modifiers of the first of them
+
+/*
+ * Queues key in the macro after the keys queued so far in this scan. Kana
+ * output goes through the macro, which is played back at the report rate,
+ * so that no romaji or dakuon expansion is cut off by the report size.
+ */
+static void queueKana(uint8_t key, uint8_t mod)
+{
+    key = getOSKey(key, &mod);
+    if (!key)
+        return;
+    if (!queued++)
+        queuedMod = mod;
+    emitModifiedKey(key, mod);
+}
+
+#if APP_MACHINE_VALUE != 0x4550
+static int8_t isThumbShift(const uint8_t* current)
+{
+    return mode == KANA_NICOLA && thumbWindows[thumb] && isKanaMode(current);
+}
+
+// Returns the window in scans.
+static uint8_t getThumbWindow(void)
+{
+    uint8_t scans = thumbWindows[thumb] / scanPeriods[scan_rate];
+
+    return scans ? scans : 1;
+}
+
+static uint8_t getThumbPlane(uint8_t thumbs)
+{
+    if (thumbs & MOD_LEFTSHIFT)
+        return 1;
+    if (thumbs & MOD_RIGHTSHIFT)
+        return 2;
+    return 0;
+}
+
+static int8_t isCharacterKey(uint8_t code)
+{
+    if (7 <= code / 12 || getKeyNumLock(code))
+        return 0;
+    return getLayoutKey(LAYOUT_NICOLA, code) || getLayoutKey(LAYOUT_NICOLA_LEFT, code) ||
+           getLayoutKey(LAYOUT_NICOLA_RIGHT, code);
+}
+
+// Called at every scan to see the thumb keys go down in time.
+void pollThumbs(const uint8_t* current)
+{
+    uint8_t thumbs = current[0] & MOD_SHIFT;
+    uint8_t pressed = thumbs & ~shift.held;
+
+    shift.held = thumbs;
+    shift.used &= thumbs;
+    if (!isThumbShift(current)) {
+        shift.pending = VOID_KEY;
         return;
     }
-    if (ROMA_LCB <= roma && roma <= ROMA_NAMI) {
-        i = roma - ROMA_LCB;
-        switch (ime) {
-        case IME_GOOGLE:
-            c = googleSet[i];
-            break;
-        case IME_APPLE:
-            c = appleSet[i];
-            break;
-        case IME_ATOK:
-            c = atokSet[i];
-            break;
-        case IME_MS:
-        default:
-            c = msSet[i];
-            break;
+    if (pressed && shift.pending != VOID_KEY && !shift.thumb &&
+        (uint8_t) (stateTick - shift.pendingTick) < getThumbWindow())
+    {
+        shift.thumb = (pressed & MOD_LEFTSHIFT) ? MOD_LEFTSHIFT : MOD_RIGHTSHIFT;
+        shift.thumbTick = stateTick;
+    }
+}
+
+// Returns non-zero once the key held back can no longer be shifted otherwise.
+int8_t isThumbDue(void)
+{
+    if (shift.pending == VOID_KEY)
+        return 0;
+    if (shift.thumb)
+        return (uint8_t) (shift.thumbTick - shift.pendingTick) <= (uint8_t) (stateTick - shift.thumbTick);
+    return getThumbWindow() <= (uint8_t) (stateTick - shift.pendingTick);
+}
+
+/*
+ * Lists in keys[] the keys of current to be typed in order with their planes
+ * in planes[], and returns how many there are. A new character key is listed
+ * with the plane of a thumb key held, or held back, and the key held back is
+ * listed first once it goes out.
+ */
+static uint8_t resolveThumbs(const uint8_t* current, const uint8_t* processed, uint8_t* keys, uint8_t* planes)
+{
+    uint8_t n = 0;
+    uint8_t thumbs = shift.held & ~shift.used;
+    int8_t pressed = 0;
+
+    for (int8_t i = 2; i < REPORT_SIZE; ++i) {
+        if (current[i] != VOID_KEY && !memchr(processed + 2, current[i], MAX_KEYS))
+            pressed = 1;
+    }
+    if (shift.pending != VOID_KEY &&
+        (pressed || isThumbDue() || !memchr(current + 2, shift.pending, MAX_KEYS)))
+    {
+        uint8_t plane = 0;
+
+        if (shift.thumb) {
+            if (pressed && (shift.thumb & shift.held) &&
+                (uint8_t) (stateTick - shift.thumbTick) < (uint8_t) (shift.thumbTick - shift.pendingTick))
+            {
+                thumbs = shift.thumb;   // Goes with the new key instead
+            } else {
+                plane = getThumbPlane(shift.thumb);
+                shift.used |= shift.thumb;
+                thumbs &= ~shift.thumb;
+            }
         }
-        for (i = 0; i < 3; ++i) {
-            uint8_t key = c[i];
-            if (isJP()) {
-                switch (key) {
-                case KEY_LEFT_BRACKET:
-                    key = KEY_RIGHT_BRACKET;
-                    break;
-                case KEY_RIGHT_BRACKET:
-                    key = KEY_NON_US_HASH;
-                    break;
-                case KEY_GRAVE_ACCENT:
-                    key = KEY_EQUAL;
-                    break;
-                case KEY_9:
-                    key = KEY_8;
-                    break;
-                case KEY_0:
-                    key = KEY_9;
-                    break;
-                default:
-                    break;
-                }
+        keys[n] = shift.pending;
+        planes[n++] = plane | HELD_BACK;
+        shift.pending = VOID_KEY;
+        shift.thumb = 0;
+    }
+    for (int8_t i = 2; i < REPORT_SIZE; ++i) {
+        uint8_t code = current[i];
+
+        if (code != VOID_KEY && !memchr(processed + 2, code, MAX_KEYS) && isCharacterKey(code)) {
+            if (thumbs) {
+                keys[n] = code;
+                planes[n++] = getThumbPlane(thumbs);
+                continue;
             }
-            a[i] = key;
+            if (shift.pending != VOID_KEY) {
+                keys[n] = shift.pending;
+                planes[n++] = HELD_BACK;
+            }
+            shift.pending = code;
+            shift.pendingTick = stateTick;
+            continue;
         }
-        return;
+        keys[n] = code;
+        planes[n++] = PLANE_AUTO;
     }
-    memset(a, 0, 3);
+    return n;
 }
+#endif
 
-static int8_t processKana(const uint8_t* current, const uint8_t* processed, uint8_t* report,
-                          const uint8_t base[][12], const uint8_t left[][12], const uint8_t right[][12])
+static int8_t processKana(const uint8_t* current, const uint8_t* processed, uint8_t* report)
 {
     uint8_t mod = current[0];
     uint8_t modifiers;
@@ -524,17 +692,36 @@ static int8_t processKana(const uint8_t* current, const uint8_t* processed, uint
     uint8_t a[3];
     const uint8_t* dakuon;
     int8_t xmit = XMIT_NORMAL;
+    uint8_t keys[REPORT_SIZE];
+    uint8_t planes[REPORT_SIZE];
+    uint8_t n;
+#if APP_MACHINE_VALUE != 0x4550
+    ThumbShift saved = shift;
+
+    if (isThumbShift(current))
+        n = resolveThumbs(current, processed, keys, planes);
+    else
+#endif
+    {
+        memcpy(keys, current + 2, MAX_KEYS);
+        memset(planes, PLANE_AUTO, MAX_KEYS);
+        n = MAX_KEYS;
+    }
 
+    queued = 0;
     modifiers = current[0] & ~MOD_SHIFT;
     report[0] = modifiers;
-    for (int8_t i = 2; i < 8 && count < 8; ++i) {
-        uint8_t code = current[i];
+    for (int8_t i = 0; i < n; ++i) {
+        uint8_t code = keys[i];
         uint8_t row = code / 12;
-        uint8_t column = code % 12;
+        uint8_t plane = planes[i] & 3;
 
         key = getKeyNumLock(code);
         if (key) {
-            report[count++] = key;
+            if (xmit == XMIT_IN_ORDER)
+                queueKana(key, current[0]);
+            else
+                report[count++] = key;
             memset(last, 0, 3);
             lastMod = current[0];
             modifiers = current[0];
@@ -551,19 +738,19 @@ static int8_t processKana(const uint8_t* current, const uint8_t* processed, uint
 
         if (7 <= row)
             roma = 0;
+        else if (plane != PLANE_AUTO)
+            roma = getLayoutKey(kanaLayouts[mode][plane], code);
         else if (mod & MOD_LEFTSHIFT)
-            roma = left[row][column];
+            roma = getLayoutKey(kanaLayouts[mode][1], code);
         else if (mod & MOD_RIGHTSHIFT)
-            roma = right[row][column];
+            roma = getLayoutKey(kanaLayouts[mode][2], code);
         else
-            roma = base[row][column];
+            roma = getLayoutKey(kanaLayouts[mode][0], code);
         if (roma && (roma < KANA_DAKUTEN || KANA_CHOUON < roma)) {
             no_repeat = 1;
-            for (int8_t j = 2; j < 8; ++j) {
+            for (int8_t j = 2; j < REPORT_SIZE && !(planes[i] & HELD_BACK); ++j) {
                 if (code == processed[j]) {
                     code = VOID_KEY;
-                    row = VOID_KEY / 12;
-                    column = VOID_KEY % 12;
                     roma = 0;
                     break;
                 }
@@ -574,45 +761,57 @@ static int8_t processKana(const uint8_t* current, const uint8_t* processed, uint
         if (!roma || !a[0]) {
             key = getKeyBase(code);
             if (key) {
-                key = toggleKanaMode(key, current[0], !memchr(processed + 2, key, 6));
-                report[count++] = key;
+                key = toggleKanaMode(key, current[0], !memchr(processed + 2, key, MAX_KEYS));
+                if (xmit == XMIT_IN_ORDER)
+                    queueKana(key, current[0]);
+                else
+                    report[count++] = key;
                 memset(last, 0, 3);
                 lastMod = current[0];
                 modifiers = current[0];
             }
             continue;
         }
-        if (no_repeat) {
-            for (int8_t i = 0; i < 3 && sent[i]; ++i) {
-                for (int8_t j = 0; j < 3 && a[j]; ++j) {
-                    if (sent[i] == a[j]) {
-                        memset(sent, 0, 3);
-                        return XMIT_BRK;
+        if (xmit != XMIT_IN_ORDER) {
+            /* The macro releases a key before it is pressed again, so only the
+             * first kana of the scan can collide with what was just sent. */
+            if (no_repeat) {
+                for (int8_t i = 0; i < 3 && sent[i]; ++i) {
+                    for (int8_t j = 0; j < 3 && a[j]; ++j) {
+                        if (sent[i] == a[j]) {
+                            memset(sent, 0, 3);
+#if APP_MACHINE_VALUE != 0x4550
+                            shift = saved;
+#endif
+                            return XMIT_BRK;
+                        }
                     }
                 }
             }
+            xmit = XMIT_IN_ORDER;
+            for (int8_t j = 2; j < count; ++j)
+                queueKana(report[j], modifiers);
+            memset(report + 2, 0, MAX_KEYS);
         }
-        xmit = XMIT_IN_ORDER;
-        for (int8_t i = 0; i < 3 && a[i] && count < 8; ++i) {
+        modifiers = 0;
+        for (int8_t i = 0; i < 3 && a[i]; ++i) {
             key = a[i];
             switch (key) {
             case KEY_DAKUTEN:
                 if (last[0]) {
                     dakuon = memchr(dakuonFrom, last[0], 4);
-                    if (dakuon && count <= 5) {
-                        report[count++] = KEY_BACKSPACE;
-                        report[count++] = dakuonTo[dakuon - dakuonFrom];
-                        report[count++] = last[1];
+                    if (dakuon) {
+                        queueKana(KEY_BACKSPACE, 0);
+                        queueKana(dakuonTo[dakuon - dakuonFrom], 0);
+                        queueKana(last[1], 0);
                     }
                 }
                 break;
             case KEY_HANDAKU:
                 if (last[0] == KEY_H) {
-                    if (count <= 5) {
-                        report[count++] = KEY_BACKSPACE;
-                        report[count++] = KEY_P;
-                        report[count++] = last[1];
-                    }
+                    queueKana(KEY_BACKSPACE, 0);
+                    queueKana(KEY_P, 0);
+                    queueKana(last[1], 0);
                 }
                 break;
             case KEY_LEFTSHIFT:
@@ -621,17 +820,20 @@ static int8_t processKana(const uint8_t* current, const uint8_t* processed, uint
             case KEY_RIGHTSHIFT:
                 modifiers |= MOD_RIGHTSHIFT;
                 break;
+            case KEY_LEFTALT:
+                modifiers |= MOD_LEFTALT;
+                break;
             default:
-                report[count++] = key;
+                queueKana(key, modifiers);
                 break;
             }
         }
         memcpy(last, a, 3);
         lastMod = current[0];
     }
-    if (2 < count) {
+    if (queued) {
         memcpy(sent, last, 3);
-        report[0] = modifiers;
+        report[0] = queuedMod;
     } else {
         memset(sent, 0, 3);
         report[0] = current[0];
@@ -670,24 +872,9 @@ uint8_t toggleKanaMode(uint8_t key, uint8_t mod, int8_t make)
 
 int8_t processKeysKana(const uint8_t* current, const uint8_t* processed, uint8_t* report)
 {
-    switch (mode) {
-    case KANA_TRON:
-        return processKana(current, processed, report, matrixTron, matrixTronLeft, matrixTronRight);
-    case KANA_NICOLA:
-        return processKana(current, processed, report, matrixNicola, matrixNicolaLeft, matrixNicolaRight);
-#ifdef ENABLE_MTYPE
-    case KANA_MTYPE:
-        return processKana(current, processed, report, matrixMtype, matrixMtypeShift, matrixMtypeShift);
-#endif
-#ifdef ENABLE_STICKNEY
-    case KANA_STICKNEY:
-        return processKana(current, processed, report, matrixStickney, matrixStickneyShift, matrixStickneyShift);
-#endif
-    case KANA_X6004:
-        return processKana(current, processed, report, matrixX6004, matrixX6004Shift, matrixX6004Shift);
-    default:
+    if (kanaLayouts[mode][0] == LAYOUT_NONE)
         return processKeysBase(current, processed, report);
-    }
+    return processKana(current, processed, report);
 }
 
 uint8_t controlKanaLED(uint8_t report)
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Generated from KeyboardLayouts.h by firmware/host/mklayout; do not edit.
+ *
+ * 18 tables [8][12]: 1728 bytes, packed: 1011 bytes
+ */
+
+#ifndef KEYBOARD_LAYOUTS_PACKED_H
+#define KEYBOARD_LAYOUTS_PACKED_H
+
+#include <stdint.h>
+
+static uint8_t const layoutParents[18] =
+{
+    LAYOUT_NONE, 0, 0, 0, 0, 4, LAYOUT_NONE, 6, LAYOUT_NONE, 6, 9, 10, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_NONE, 6, 8
+};
+
+static uint16_t const layoutColumns[18][8] =
+{
+    {0xfff, 0xc03, 0xc03, 0xf9f, 0xf9f, 0xfff, 0xfff, 0xfff},
+    {0x801, 0x801, 0xc03, 0xf9f, 0xf9f, 0x87e, 0xef5, 0xfff},
+    {0x800, 0x800, 0x800, 0x800, 0xf9f, 0xf9e, 0xe9f, 0x000},
+    {0x000, 0x000, 0x000, 0x001, 0xf9c, 0xf1e, 0x080, 0x010},
+    {0x001, 0x801, 0x001, 0x000, 0x000, 0x000, 0x000, 0x000},
+    {0x800, 0x000, 0x800, 0x801, 0x000, 0x000, 0x000, 0x010},
+    {0x001, 0x000, 0x001, 0x000, 0xf9f, 0xf9f, 0xf9f, 0x000},
+    {0x000, 0x001, 0x000, 0x000, 0xf9f, 0xf9f, 0xf9f, 0x000},
+    {0x001, 0x000, 0x001, 0x000, 0xf9f, 0xf9f, 0xf9f, 0x000},
+    {0x800, 0x000, 0x800, 0x000, 0xd9f, 0x79f, 0xf9f, 0x000},
+    {0x000, 0x000, 0x002, 0x19e, 0xf9f, 0x79f, 0x79f, 0x000},
+    {0x801, 0x000, 0x001, 0x000, 0xf9f, 0xf9f, 0xf9f, 0x000},
+    {0x000, 0x000, 0x000, 0x000, 0xf9f, 0xf9f, 0xf9f, 0x000},
+    {0x000, 0x000, 0x000, 0x000, 0xf9f, 0xf9f, 0xf9f, 0x000},
+    {0x001, 0x000, 0x803, 0x800, 0x800, 0x000, 0x804, 0x000},
+    {0x001, 0x000, 0x801, 0x800, 0x808, 0x71c, 0x100, 0x000},
+    {0x000, 0x000, 0x800, 0x800, 0xf8f, 0xf9f, 0x993, 0x000},
+    {0x000, 0x000, 0x800, 0x800, 0xf9f, 0xf9f, 0xf9f, 0x000},
+};
+
+static uint16_t const layoutOffsets[18] =
+{
+    0, 76, 132, 164, 183, 187, 192, 224, 255, 287, 317, 352, 385, 415, 445, 453, 466, 493
+};
+
+static uint8_t const layoutRowOffsets[18][8] =
+{
+    {0, 12, 16, 20, 30, 40, 52, 64},
+    {0, 2, 4, 8, 18, 28, 35, 44},
+    {0, 1, 2, 3, 4, 14, 23, 32},
+    {0, 0, 0, 0, 1, 9, 17, 18},
+    {0, 1, 3, 4, 4, 4, 4, 4},
+    {0, 1, 1, 2, 4, 4, 4, 4},
+    {0, 1, 1, 2, 2, 12, 22, 32},
+    {0, 0, 1, 1, 1, 11, 21, 31},
+    {0, 1, 1, 2, 2, 12, 22, 32},
+    {0, 1, 1, 2, 2, 11, 20, 30},
+    {0, 0, 0, 1, 7, 17, 26, 35},
+    {0, 2, 2, 3, 3, 13, 23, 33},
+    {0, 0, 0, 0, 0, 10, 20, 30},
+    {0, 0, 0, 0, 0, 10, 20, 30},
+    {0, 1, 1, 4, 5, 6, 6, 8},
+    {0, 1, 1, 3, 4, 6, 12, 13},
+    {0, 0, 0, 1, 2, 11, 21, 27},
+    {0, 0, 0, 1, 2, 12, 22, 32},
+};
+
+static uint8_t const layoutKeys[525] =
+{
+    // [0]
+    0x2f, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, 0x40, 0x41, 0x42, 0x43, 0x44, 0x2e,
+    0x35, 0x3a, 0x45, 0x31,
+    0x30, 0x1e, 0x27, 0x2d,
+    0x39, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x34,
+    0x14, 0x1a, 0x08, 0x15, 0x17, 0x1c, 0x18, 0x0c, 0x12, 0x13,
+    0x04, 0x16, 0x07, 0x09, 0x0a, 0x29, 0x65, 0x0b, 0x0d, 0x0e, 0x0f, 0x33,
+    0x1d, 0x1b, 0x06, 0x19, 0x05, 0x2b, 0x28, 0x11, 0x10, 0x36, 0x37, 0x38,
+    0xe0, 0xe3, 0xf0, 0xe1, 0x2a, 0xe2, 0xe6, 0x2c, 0xe5, 0xf1, 0xe7, 0xe4,
+    // [1]
+    0x00, 0x00,
+    0x28, 0xf5,
+    0x00, 0x00, 0x4c, 0x00,
+    0x38, 0x00, 0x29, 0x00, 0x00, 0x00, 0x00, 0x2b, 0x00, 0x2a,
+    0x00, 0x1c, 0x12, 0x13, 0x1d, 0x09, 0x07, 0x17, 0x15, 0x00,
+    0x0c, 0x08, 0x18, 0x1a, 0x4e, 0x4b, 0x11,
+    0x37, 0x14, 0x34, 0x33, 0xec, 0x05, 0x0a, 0x06, 0x16,
+    0xe1, 0xe6, 0xe3, 0x2c, 0x39, 0xe0, 0xf2, 0x36, 0xf1, 0xe2, 0xe6, 0xe5,
+    // [2]
+    0x31,
+    0x2e,
+    0x38,
+    0x2d,
+    0x34, 0x36, 0x37, 0x13, 0x1c, 0x09, 0x0a, 0x06, 0x15, 0x0f,
+    0x12, 0x08, 0x18, 0x0c, 0x07, 0x0b, 0x17, 0x11, 0x16,
+    0x33, 0x14, 0x0d, 0x0e, 0x1b, 0x05, 0x1a, 0x19, 0x1d,
+    // [3]
+    0x2a,
+    0x09, 0x13, 0x0a, 0x0d, 0x0f, 0x18, 0x1c, 0x33,
+    0x15, 0x16, 0x17, 0x07, 0x11, 0x08, 0x0c, 0x12,
+    0x0e,
+    0x2c,
+    // [4]
+    0x30,
+    0x89, 0x2f,
+    0x32,
+    // [5]
+    0x2d,
+    0x34,
+    0x2e, 0x2a,
+    0x58,
+    // [6]
+    0xe6,
+    0xe7,
+    0x39, 0x3b, 0x0c, 0x24, 0x83, 0x09, 0x21, 0x0a, 0x01, 0x3c,
+    0x16, 0x1a, 0x08, 0x19, 0x2f, 0x44, 0x02, 0x03, 0x10, 0xc8,
+    0x2b, 0x3a, 0x1e, 0x0f, 0x1d, 0x11, 0x18, 0xcd, 0xce, 0x7a,
+    // [7]
+    0xee,
+    0x25, 0x13, 0xec, 0x7f, 0x28, 0x4f, 0x51, 0x50, 0xcc, 0x8e,
+    0x1f, 0x20, 0x81, 0x36, 0x26, 0xca, 0x5d, 0x96, 0x56, 0x90,
+    0x6d, 0x6e, 0x12, 0x34, 0x27, 0x57, 0x5e, 0xef, 0xf0, 0x86,
+    // [8]
+    0xe8,
+    0xe9,
+    0x64, 0x59, 0x52, 0x63, 0x67, 0x04, 0x0b, 0x2e, 0x2d, 0x3d,
+    0x5c, 0x60, 0x4e, 0x5f, 0x65, 0x05, 0x17, 0xc9, 0x2c, 0x32,
+    0x71, 0x74, 0x58, 0x55, 0x66, 0x40, 0x6b, 0x6a, 0xcb, 0x6c,
+    // [9]
+    0xca,
+    0xcd,
+    0xce, 0x08, 0x16, 0x0c, 0x0f, 0x39, 0x17, 0x18, 0xcd,
+    0x03, 0x10, 0x19, 0x0b, 0x12, 0x24, 0x1a, 0x09, 0x02,
+    0xce, 0x25, 0x11, 0x26, 0x27, 0x2e, 0x13, 0x20, 0x28, 0xec,
+    // [10]
+    0xcc,
+    0xed, 0xf1, 0xe6, 0xe7, 0xea, 0xeb,
+    0x6a, 0x04, 0x3a, 0x7f, 0x3c, 0x47, 0x5d, 0x50, 0x5e, 0x48,
+    0x44, 0x01, 0x1d, 0x81, 0x2f, 0x63, 0x60, 0x4f, 0x4b,
+    0x6c, 0xc9, 0x3d, 0x32, 0x6b, 0x49, 0x59, 0x4a, 0x67,
+    // [11]
+    0xe8, 0xcb,
+    0xe9,
+    0xce, 0x4e, 0x5c, 0x52, 0x55, 0x36, 0x1e, 0x3b, 0x2b, 0x6d,
+    0x96, 0x56, 0x5f, 0x51, 0x58, 0x2c, 0x05, 0x21, 0x83, 0x7a,
+    0xce, 0x64, 0x57, 0x65, 0x66, 0x1f, 0x34, 0x2d, 0x40, 0x6e,
+    // [12]
+    0xb6, 0x9a, 0xb5, 0xb4, 0xb3, 0x2a, 0x31, 0x38, 0x3f, 0x46,
+    0x04, 0x03, 0x02, 0x01, 0x05, 0x07, 0x0e, 0x15, 0x1c, 0x23,
+    0xae, 0x69, 0x93, 0xa4, 0xb2, 0x4d, 0x54, 0x5b, 0xcd, 0x62,
+    // [13]
+    0xac, 0xa9, 0xa6, 0xa2, 0xb0, 0x30, 0x7a, 0x3e, 0xc8, 0x4c,
+    0xab, 0xa8, 0xa5, 0xa1, 0xaf, 0x0d, 0x14, 0x1b, 0x22, 0x29,
+    0xad, 0xaa, 0xa7, 0xa3, 0xb1, 0x53, 0x5a, 0x61, 0xce, 0x68,
+    // [14]
+    0xd3,
+    0xd4, 0xd7, 0xde,
+    0xdd,
+    0xd1,
+    0xdb, 0xe0,
+    // [15]
+    0xd3,
+    0xd4, 0xde,
+    0xdf,
+    0xb3, 0xd2,
+    0x46, 0xd6, 0xd5, 0xd9, 0xd8, 0xdc,
+    0xda,
+    // [16]
+    0x17,
+    0x1d,
+    0x13, 0x0b, 0x12, 0x19, 0x18, 0xc8, 0x21, 0x44, 0x3a,
+    0x24, 0x08, 0x10, 0x1a, 0x16, 0x0a, 0x03, 0x02, 0xca, 0x09,
+    0x11, 0x0c, 0x01, 0x7a, 0x3b, 0x3c,
+    // [17]
+    0xe6,
+    0xe7,
+    0x6a, 0xcb, 0x28, 0x26, 0x2e, 0x25, 0x04, 0x2c, 0x32, 0x1f,
+    0x6b, 0x27, 0x39, 0x81, 0x36, 0x2b, 0x05, 0x2f, 0x40, 0x34,
+    0x6c, 0x6d, 0x6e, 0x20, 0x7f, 0x2d, 0x3d, 0xec, 0xc9, 0xcc,
+};
+
+#endif  // #ifndef KEYBOARD_LAYOUTS_PACKED_H
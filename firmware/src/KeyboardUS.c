@@ -23,102 +23,28 @@ static uint8_t const baseKeys[BASE_MAX + 1][5] =
 {
     {KEY_U, KEY_S, KEY_MINUS, KEY_Z, KEY_ENTER},
     {KEY_U, KEY_S, KEY_MINUS, KEY_K, KEY_ENTER},
+    {KEY_C, KEY_O, KEY_L, KEY_E, KEY_ENTER},
+    {KEY_J, KEY_I, KEY_S, KEY_ENTER},
+    {KEY_N, KEY_I, KEY_C, KEY_O, KEY_ENTER},
+    {KEY_D, KEY_V, KEY_O, KEY_R, KEY_ENTER},
+    {KEY_Q, KEY_W, KEY_E, KEY_R, KEY_ENTER},
 };
 
-/*
-static uint8_t const matrixQwerty[8][12] =
-{
-    KEY_LEFT_BRACKET, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_EQUAL,
-    KEY_GRAVE_ACCENT, KEY_F1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_F12, KEY_BACKSLASH,
-    KEY_RIGHT_BRACKET, KEY_1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_0, KEY_MINUS,
-    KEY_CAPS_LOCK, KEY_2, KEY_3, KEY_4, KEY_5, 0, 0, KEY_6, KEY_7, KEY_8, KEY_9, KEY_QUOTE,
-    KEY_Q, KEY_W, KEY_E, KEY_R, KEY_T, 0, 0, KEY_Y, KEY_U, KEY_I, KEY_O, KEY_P,
-    KEY_A, KEY_S, KEY_D, KEY_F, KEY_G, KEY_ESCAPE, KEY_APPLICATION, KEY_H, KEY_J, KEY_K, KEY_L, KEY_SEMICOLON,
-    KEY_Z, KEY_X, KEY_C, KEY_V, KEY_B, KEY_TAB, KEY_ENTER, KEY_N, KEY_M, KEY_COMMA, KEY_PERIOD, KEY_SLASH,
-    KEY_LEFTCONTROL, KEY_LEFT_GUI, KEY_LEFT_FN, KEY_LEFTSHIFT, KEY_BACKSPACE, KEY_LEFTALT, KEY_RIGHTALT, KEY_SPACEBAR, KEY_RIGHTSHIFT, KEY_RIGHT_FN, KEY_RIGHT_GUI, KEY_RIGHTCONTROL
-};
-
-static uint8_t const matrixDvorak[8][12] =
-{
-    KEY_LEFT_BRACKET, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_BACKSLASH,
-    KEY_GRAVE_ACCENT, KEY_F1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_F12, KEY_EQUAL,
-    KEY_RIGHT_BRACKET, KEY_1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_0, KEY_SLASH,
-    KEY_CAPS_LOCK, KEY_2, KEY_3, KEY_4, KEY_5, 0, 0, KEY_6, KEY_7, KEY_8, KEY_9, KEY_MINUS,
-    KEY_QUOTE, KEY_COMMA, KEY_PERIOD, KEY_P, KEY_Y, 0, 0, KEY_F, KEY_G, KEY_C, KEY_R, KEY_L,
-    KEY_A, KEY_O, KEY_E, KEY_U, KEY_I, KEY_ESCAPE, KEY_APPLICATION, KEY_D, KEY_H, KEY_T, KEY_N, KEY_S,
-    KEY_SEMICOLON, KEY_Q, KEY_J, KEY_K, KEY_X, KEY_TAB, KEY_ENTER, KEY_B, KEY_M, KEY_W, KEY_V, KEY_Z,
-    KEY_LEFTCONTROL, KEY_LEFT_GUI, KEY_LEFT_FN, KEY_LEFTSHIFT, KEY_BACKSPACE, KEY_LEFTALT, KEY_RIGHTALT, KEY_SPACEBAR, KEY_RIGHTSHIFT, KEY_RIGHT_FN, KEY_RIGHT_GUI, KEY_RIGHTCONTROL
-};
-
-static uint8_t const matrixColemak[8][12] =
-{
-    KEY_LEFT_BRACKET, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_EQUAL,
-    KEY_GRAVE_ACCENT, KEY_F1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_F12, KEY_BACKSLASH,
-    KEY_RIGHT_BRACKET, KEY_1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_0, KEY_MINUS,
-    KEY_BACKSPACE, KEY_2, KEY_3, KEY_4, KEY_5, 0, 0, KEY_6, KEY_7, KEY_8, KEY_9, KEY_QUOTE,
-    KEY_Q, KEY_W, KEY_F, KEY_P, KEY_G, 0, 0, KEY_J, KEY_L, KEY_U, KEY_Y, KEY_SEMICOLON,
-    KEY_A, KEY_R, KEY_S, KEY_T, KEY_D, KEY_ESCAPE, KEY_APPLICATION, KEY_H, KEY_N, KEY_E, KEY_I, KEY_O,
-    KEY_Z, KEY_X, KEY_C, KEY_V, KEY_B, KEY_TAB, KEY_ENTER, KEY_K, KEY_M, KEY_COMMA, KEY_PERIOD, KEY_SLASH,
-    KEY_LEFTCONTROL, KEY_LEFT_GUI, KEY_LEFT_FN, KEY_LEFTSHIFT, KEY_SPACEBAR, KEY_LEFTALT, KEY_RIGHTALT, KEY_SPACEBAR, KEY_RIGHTSHIFT, KEY_RIGHT_FN, KEY_RIGHT_GUI, KEY_RIGHTCONTROL
-};
-*/
-
-static uint8_t const matrixZq[8][12] =
-{
-    00, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, 00,
-    KEY_ENTER, KEY_F1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_F12, KEY_ZQ_COLON,
-    00, 00, 0, 0, 0, 0, 0, 0, 0, 0, KEY_DELETE, 00,
-    KEY_SLASH, 00, KEY_ESCAPE, 00 , 00,                           0, 0, 00, 00, KEY_TAB, 00, KEY_BACKSPACE,
-    00,            KEY_Y, KEY_O, KEY_P, KEY_Z,                    0, 0,                                 KEY_F, KEY_D, KEY_T, KEY_R, 00,
-    KEY_A,         KEY_I, KEY_E, KEY_U, KEY_W,                    KEY_PAGEDOWN, KEY_PAGEUP,             KEY_H, KEY_J, KEY_K, KEY_L, KEY_N,
-    KEY_PERIOD,    KEY_X, KEY_Q, KEY_V, KEY_QUOTE,                KEY_SEMICOLON,KEY_ZQ_DOUBLE_QUOTE,    KEY_B, KEY_M, KEY_G, KEY_C, KEY_S,
-    KEY_LEFTSHIFT, KEY_RIGHTALT, KEY_LEFT_GUI, KEY_SPACEBAR, KEY_CAPS_LOCK, KEY_LEFTCONTROL, KEY_FN2, KEY_COMMA, KEY_RIGHT_FN, KEY_LEFTALT, KEY_RIGHTALT, KEY_RIGHTSHIFT
-};
-
-//
-// Japanese layouts
-//
-// [{   KEY_RIGHT_BRACKET
-// ]}   KEY_NON_US_HASH
-// \|   KEY_INTERNATIONAL3
-// @`   KEY_LEFT_BRACKET
-// -=   KEY_MINUS
-// :*   KEY_QUOTE
-// ^~   KEY_EQUAL
-//  _   KEY_INTERNATIONAL1
-// no-convert   KEY_INTERNATIONAL5
-// convert      KEY_INTERNATIONAL4
-// hiragana     KEY_INTERNATIONAL2
-// zenkaku      KEY_GRAVE_ACCENT
-//
-
-static uint8_t const matrixJIS[8][12] =
-{
-    KEY_RIGHT_BRACKET, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_EQUAL,
-    KEY_INTERNATIONAL3, KEY_F1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_F12, KEY_LEFT_BRACKET,
-    KEY_NON_US_HASH, KEY_1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_0, KEY_MINUS,
-    KEY_CAPS_LOCK, KEY_2, KEY_3, KEY_4, KEY_5, 0, 0, KEY_6, KEY_7, KEY_8, KEY_9, KEY_QUOTE,
-    KEY_Q, KEY_W, KEY_E, KEY_R, KEY_T, 0, 0, KEY_Y, KEY_U, KEY_I, KEY_O, KEY_P,
-    KEY_A, KEY_S, KEY_D, KEY_F, KEY_G, KEY_ESCAPE, KEY_APPLICATION, KEY_H, KEY_J, KEY_K, KEY_L, KEY_SEMICOLON,
-    KEY_Z, KEY_X, KEY_C, KEY_V, KEY_B, KEY_TAB, KEY_ENTER, KEY_N, KEY_M, KEY_COMMA, KEY_PERIOD, KEY_SLASH,
-    KEY_LEFTCONTROL, KEY_LEFT_GUI, KEY_LEFT_FN, KEY_LEFTSHIFT, KEY_BACKSPACE, KEY_LEFTALT, KEY_RIGHTALT, KEY_SPACEBAR, KEY_RIGHTSHIFT, KEY_RIGHT_FN, KEY_RIGHT_GUI, KEY_RIGHTCONTROL
-};
-
-static uint8_t const matrixNicolaF[8][12] =
+static uint8_t const baseLayouts[BASE_MAX + 1] =
 {
-    KEY_RIGHT_BRACKET, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_MINUS,
-    KEY_INTERNATIONAL3, KEY_F1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_F12, KEY_LEFT_BRACKET,
-    KEY_NON_US_HASH, KEY_1, 0, 0, 0, 0, 0, 0, 0, 0, KEY_0, KEY_QUOTE,
-    KEY_EQUAL, KEY_2, KEY_3, KEY_4, KEY_5, 0, 0, KEY_6, KEY_7, KEY_8, KEY_9, KEY_BACKSPACE,
-    KEY_Q, KEY_W, KEY_E, KEY_R, KEY_T, 0, 0, KEY_Y, KEY_U, KEY_I, KEY_O, KEY_P,
-    KEY_A, KEY_S, KEY_D, KEY_F, KEY_G, KEY_ESCAPE, KEY_APPLICATION, KEY_H, KEY_J, KEY_K, KEY_L, KEY_SEMICOLON,
-    KEY_Z, KEY_X, KEY_C, KEY_V, KEY_B, KEY_TAB, KEY_ENTER, KEY_N, KEY_M, KEY_COMMA, KEY_PERIOD, KEY_SLASH,
-    KEY_LEFTCONTROL, KEY_LEFT_GUI, KEY_LEFT_FN, KEY_LEFTSHIFT, KEYPAD_ENTER, KEY_LEFTALT, KEY_RIGHTALT, KEY_SPACEBAR, KEY_RIGHTSHIFT, KEY_RIGHT_FN, KEY_RIGHT_GUI, KEY_RIGHTCONTROL
+    LAYOUT_ZQ, LAYOUT_ZQ, LAYOUT_COLEMAK, LAYOUT_JIS, LAYOUT_NICOLA_F, LAYOUT_DVORAK, LAYOUT_QWERTY
 };
 
 static uint8_t mode;
 static uint8_t lastShift;
 
+/*
+ * The keys of the base layout with the NumLock keys and the modifier
+ * remapping already applied, for each code of the matrix. Rebuilt by
+ * updateKeymap() whenever one of them changes.
+ */
+static uint8_t keymap[96];
+
 void loadBaseSettings(void)
 {
     mode = ReadNvram(EEPROM_BASE);
@@ -137,6 +63,8 @@ void switchBase(void)
     if (BASE_MAX < mode)
         mode = 0;
     WriteNvram(EEPROM_BASE, mode);
+    updateKeymap();
+    updateRomaji();
 //    emitBaseName();
 }
 
@@ -152,12 +80,9 @@ int8_t isJP(void)
 
 int8_t pressed(const uint8_t* current, const uint8_t* processed, uint8_t modifiers, uint8_t k)
 {
-    for (int8_t i = 2; i < 8; ++i) {
-        uint8_t code = current[i];
-        uint8_t key = getKeyNumLock(code);
-        if (!key)
-            key = getKeyBase(code);
-        key = toggleKanaMode(key, modifiers, !memchr(processed + 2, key, 6));
+    for (int8_t i = 2; i < REPORT_SIZE; ++i) {
+        uint8_t key = getKeyBase(current[i]);
+        key = toggleKanaMode(key, modifiers, !memchr(processed + 2, key, MAX_KEYS));
         if (k == key)
             return 1;
     }
@@ -193,13 +118,10 @@ int8_t processKeysBase(const uint8_t* current, const uint8_t* processed, uint8_t
     if (!(current[1] & MOD_PAD)) {
         uint8_t count = 2;
         uint8_t key_zq;
-        /* We loop 6 times, presumably because of 6-key rollover. */
-        for (int8_t i = 2; i < 8; ++i) {
-            uint8_t code = current[i];
-            uint8_t key = getKeyNumLock(code);
-            if (!key)
-                key = getKeyBase(code);
-            key = toggleKanaMode(key, modifiers, !memchr(processed + 2, key, 6));
+        /* We loop MAX_KEYS times, once for each key in current[]. */
+        for (int8_t i = 2; i < REPORT_SIZE; ++i) {
+            uint8_t key = getKeyBase(current[i]);
+            key = toggleKanaMode(key, modifiers, !memchr(processed + 2, key, MAX_KEYS));
 
             /* Process special keys that are private to ZQ layout. */
             switch (key) {
@@ -207,7 +129,7 @@ int8_t processKeysBase(const uint8_t* current, const uint8_t* processed, uint8_t
             case KEY_ZQ_COLON:
 
                 modifiers |= MOD_LEFTSHIFT;
-                i = 8;
+                i = REPORT_SIZE;
                 switch (key) {
                     case KEY_ZQ_DOUBLE_QUOTE:   key_zq = KEY_QUOTE; break;
                     case KEY_ZQ_COLON:          key_zq = KEY_SEMICOLON; break;
@@ -228,7 +150,7 @@ int8_t processKeysBase(const uint8_t* current, const uint8_t* processed, uint8_t
             case KEY_PERIOD:
                 report[count++] = key;
                 if (mode == BASE_ZQ)
-                    i = 8;
+                    i = REPORT_SIZE;
                 break;
             default:
                 /* Take into consideration the lastShift and lastExtra keys, if
@@ -260,7 +182,7 @@ int8_t processKeysBase(const uint8_t* current, const uint8_t* processed, uint8_t
                      * to press SHIFT+CAPS_LOCK as part of one keypress
                      * ("report").
                      */
-                    if (memcmp(current, processed, 8)
+                    if (memcmp(current, processed, REPORT_SIZE)
                         && !pressed(current, processed, modifiers, KEY_CAPS_LOCK)) {
                         lastShift = 0;
                         goto exit_loop;
@@ -296,7 +218,7 @@ exit_loop:
 
 uint8_t controlZQLED(uint8_t report)
 {
-    if (mode == BASE_ZQ || mode == BASE_QWERTY) {
+    if (mode == BASE_ZQ || mode == BASE_ZQ_K) {
         if (prefix & MOD_SHIFT)
             report |= LED_SCROLL_LOCK;
         if (prefixExtra & MOD_FN)
@@ -310,40 +232,20 @@ uint8_t controlZQLED(uint8_t report)
 
 int8_t isZQMode(const uint8_t* current)
 {
-    return !(current[0] & (MOD_ALT | MOD_CONTROL | MOD_GUI)) && !(current[1] & MOD_PAD) && (mode == BASE_ZQ || mode == BASE_QWERTY);
+    return !(current[0] & (MOD_ALT | MOD_CONTROL | MOD_GUI)) && !(current[1] & MOD_PAD) && (mode == BASE_ZQ || mode == BASE_ZQ_K);
 }
 
-uint8_t getKeyBase(uint8_t code)
+void updateKeymap(void)
 {
-    uint8_t key = getKeyNumLock(code);
-    uint8_t row = code / 12;
-    uint8_t column = code % 12;
-    if (key)
-        return key;
-    switch (mode) {
-    /*
-    case BASE_QWERTY:
-        key = matrixQwerty[row][column];
-        break;
-    case BASE_DVORAK:
-        key = matrixDvorak[row][column];
-        break;
-    case BASE_COLEMAK:
-        key = matrixColemak[row][column];
-        break;
-    */
-    case BASE_JIS:
-        key = matrixJIS[row][column];
-        break;
-    case BASE_NICOLA_F:
-        key = matrixNicolaF[row][column];
-        break;
-    case BASE_ZQ:
-        key = matrixZq[row][column];
-        break;
-    default:
-        key = matrixZq[row][column];
-        break;
+    for (uint8_t code = 0; code < 96; ++code) {
+        uint8_t key = getKeyNumLock(code);
+        if (!key)
+            key = processModKey(getLayoutKey(baseLayouts[mode], code));
+        keymap[code] = key;
     }
-    return processModKey(key);
+}
+
+uint8_t getKeyBase(uint8_t code)
+{
+    return keymap[code];
 }
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Latency.h"
+#include "Keyboard.h"
+
+#include <string.h>
+
+#if APP_MACHINE_VALUE != 0x4550
+
+#define MAX_PENDING     6
+#define MAX_AGE         (1u << (LATENCY_SHIFT + LATENCY_BUCKETS))   // Stamps older than this are dropped
+
+static const uint8_t about_latency[] = {
+    KEY_L, KEY_A, KEY_T, 0
+};
+
+static uint16_t now;
+static uint8_t pendingCodes[MAX_PENDING];
+static uint16_t pendingTicks[MAX_PENDING];
+static uint8_t reported;        // bit i is set once pendingCodes[i] is in a report
+static uint16_t histogram[LATENCY_BUCKETS];
+
+void initLatency(void)
+{
+    memset(pendingCodes, VOID_KEY, MAX_PENDING);
+    reported = 0;
+    memset(histogram, 0, sizeof histogram);
+}
+
+void setLatencyTick(uint16_t tick)
+{
+    now = tick;
+}
+
+// Stamps code, which has just been found pressed, with the current tick.
+void startLatency(uint8_t code)
+{
+    uint8_t* slot;
+
+    if (memchr(pendingCodes, code, MAX_PENDING))
+        return;
+    slot = memchr(pendingCodes, VOID_KEY, MAX_PENDING);
+    if (slot) {
+        *slot = code;
+        pendingTicks[slot - pendingCodes] = now;
+    }
+}
+
+// Marks the stamped codes that made it into keys[MAX_KEYS] as reported.
+void stopLatency(const uint8_t* keys)
+{
+    for (int8_t i = 0; i < MAX_PENDING; ++i) {
+        uint8_t code = pendingCodes[i];
+
+        if (code == VOID_KEY || (reported & (1u << i)))
+            continue;
+        if (memchr(keys, code, MAX_KEYS))
+            reported |= 1u << i;
+        else if (MAX_AGE <= (uint16_t) (now - pendingTicks[i]))
+            pendingCodes[i] = VOID_KEY;     // Give up on old stamps, e.g., glitches.
+    }
+}
+
+/*
+ * Records the latency of the reported codes at tick, when the newest queued
+ * report, and thus every report carrying them, has been handed to the IN
+ * endpoint.
+ */
+void sendLatency(uint16_t tick)
+{
+    for (int8_t i = 0; reported; ++i) {
+        uint16_t delta;
+        uint8_t bucket = 0;
+
+        if (!(reported & (1u << i)))
+            continue;
+        reported &= ~(1u << i);
+        delta = (uint16_t) (tick - pendingTicks[i]);
+        delta >>= LATENCY_SHIFT;
+        while (delta && bucket < LATENCY_BUCKETS - 1) {
+            delta >>= 1;
+            ++bucket;
+        }
+        if (histogram[bucket] < UINT16_MAX)
+            ++histogram[bucket];
+        pendingCodes[i] = VOID_KEY;
+    }
+}
+
+const uint16_t* getLatencyHistogram(void)
+{
+    return histogram;
+}
+
+void emitLatency(void)
+{
+    emitString(about_latency);
+    for (int8_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        emitKey(KEY_SPACEBAR);
+        emitNumber(histogram[i]);
+    }
+    emitKey(KEY_ENTER);
+}
+
+#endif
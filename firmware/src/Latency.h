@@ -0,0 +1,58 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <system.h>
+
+/*
+ * Key press latency histogram
+ *
+ * Latency is measured in Timer0 ticks (256 / (_XTAL_FREQ / 4), i.e.,
+ * 21.3 [usec] at 48 [MHz]) from the first scan in which a key is found
+ * pressed to the time the first report carrying it is handed to the IN
+ * endpoint, i.e., sendLatency() is called once the report queue has run dry.
+ * Bucket 0 counts latencies below (1 << LATENCY_SHIFT) ticks, and bucket n
+ * counts latencies in [1 << (LATENCY_SHIFT + n - 1), 1 << (LATENCY_SHIFT + n))
+ * ticks. The last bucket also counts everything beyond it.
+ */
+
+#define LATENCY_SHIFT       6   // 64 ticks = 1.4 [msec]
+#define LATENCY_BUCKETS     9
+
+#if APP_MACHINE_VALUE != 0x4550
+
+void initLatency(void);
+void setLatencyTick(uint16_t tick);
+void startLatency(uint8_t code);
+void stopLatency(const uint8_t* keys);
+void sendLatency(uint16_t tick);
+const uint16_t* getLatencyHistogram(void);
+void emitLatency(void);
+
+#else
+
+#define initLatency()
+#define setLatencyTick(tick)
+#define startLatency(code)
+#define stopLatency(keys)
+#define sendLatency(tick)
+
+#endif
+
+#endif  // #ifndef LATENCY_H
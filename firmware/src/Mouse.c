@@ -117,7 +117,7 @@ void processMouseKeys(uint8_t* current, const uint8_t* processed)
     uint8_t b = 0;
     int8_t w = 0;
 
-    for (uint8_t i = 2; i < 8; ++i) {
+    for (uint8_t i = 2; i < REPORT_SIZE; ++i) {
         uint8_t code = current[i];
         switch (code) {
         case CODE_F9:
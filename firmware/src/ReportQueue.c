@@ -0,0 +1,85 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ReportQueue.h"
+
+#include <string.h>
+
+#define REPORT_QUEUE_MASK   (REPORT_QUEUE_SIZE - 1)
+
+static uint8_t queue[REPORT_QUEUE_SIZE][REPORT_SIZE];
+static uint8_t head;    // index of the oldest report
+static uint8_t count;
+static uint16_t overflowCount;
+
+void initReportQueue(void)
+{
+    memset(queue, 0, sizeof queue);     // the host starts with no keys pressed
+    head = 0;
+    count = 0;
+    overflowCount = 0;
+}
+
+void queueReport(const uint8_t* report)
+{
+    /* The newest entry keeps the last report even after it has been sent and
+     * dropped, so a report the host has seen or is going to see is skipped. */
+    uint8_t* newest = queue[(head + count - 1) & REPORT_QUEUE_MASK];
+
+    if (!memcmp(newest, report, REPORT_SIZE))
+        return;
+    if (count < REPORT_QUEUE_SIZE)
+        newest = queue[(head + count++) & REPORT_QUEUE_MASK];
+    else if (overflowCount < UINT16_MAX)
+        ++overflowCount;
+    memcpy(newest, report, REPORT_SIZE);
+}
+
+// Returns the oldest queued report, or NULL if the queue is empty.
+const uint8_t* peekReport(void)
+{
+    if (!count)
+        return NULL;
+    return queue[head];
+}
+
+void dropReport(void)
+{
+    if (count) {
+        head = (head + 1) & REPORT_QUEUE_MASK;
+        --count;
+    }
+}
+
+uint16_t getReportOverflowCount(void)
+{
+    return overflowCount;
+}
+
+#if APP_MACHINE_VALUE != 0x4550
+
+static const uint8_t about_queue[] = {
+    KEY_Q, KEY_U, KEY_E, KEY_U, KEY_E, KEY_SPACEBAR, 0
+};
+
+void emitReportOverflowCount(void)
+{
+    emitString(about_queue);
+    emitNumber(overflowCount);
+    emitKey(KEY_ENTER);
+}
+
+#endif
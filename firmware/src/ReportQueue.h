@@ -0,0 +1,49 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REPORT_QUEUE_H
+#define REPORT_QUEUE_H
+
+#include <stdint.h>
+#include <system.h>
+
+#include "Keyboard.h"
+
+/*
+ * Report queue
+ *
+ * Holds the reports made by the matrix scan until the IN endpoint takes
+ * them so that the matrix can be scanned at a fixed rate however slowly the
+ * host polls the keyboard. Each entry is a REPORT_SIZE byte report in the
+ * layout made by makeReport(). A report identical to the last one queued is
+ * not queued again, as it would not tell the host anything new. If the queue
+ * is full, a new report replaces the newest queued one and the overflow is
+ * counted.
+ */
+
+#define REPORT_QUEUE_SIZE   8   // must be a power of two
+
+void initReportQueue(void);
+void queueReport(const uint8_t* report);
+const uint8_t* peekReport(void);
+void dropReport(void);
+uint16_t getReportOverflowCount(void);
+
+#if APP_MACHINE_VALUE != 0x4550
+void emitReportOverflowCount(void);
+#endif
+
+#endif  // #ifndef REPORT_QUEUE_H
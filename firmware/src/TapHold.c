@@ -0,0 +1,287 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TapHold.h"
+#include "Keyboard.h"
+
+#include <string.h>
+
+#if APP_MACHINE_VALUE != 0x4550
+
+#define HOLD_ON_OTHER_KEY_PRESS 1u
+#define PERMISSIVE_HOLD         2u
+#define QUICK_TAP               4u
+
+#define MAX_BUFFERED    MAX_KEYS
+#define KEY_BYTES       12      // The size of a key state bitmap
+
+typedef struct TapHoldKey {
+    uint8_t code;       // Key matrix index, or VOID_KEY at the end of a table
+    uint8_t mod;        // Modifiers while held
+    uint8_t modExtra;   // MOD_FN or MOD_FN2 while held
+    uint8_t flags;
+} TapHoldKey;
+
+static TapHoldKey const noKeys[] = {
+    { VOID_KEY },
+};
+
+static TapHoldKey const homeKeys[] = {
+    { 60, MOD_LEFTGUI, 0, PERMISSIVE_HOLD | QUICK_TAP },        // A
+    { 61, MOD_LEFTALT, 0, PERMISSIVE_HOLD | QUICK_TAP },        // S
+    { 62, MOD_LEFTCONTROL, 0, PERMISSIVE_HOLD | QUICK_TAP },    // D
+    { 63, MOD_LEFTSHIFT, 0, PERMISSIVE_HOLD | QUICK_TAP },      // F
+    { 68, MOD_RIGHTSHIFT, 0, PERMISSIVE_HOLD | QUICK_TAP },     // J
+    { 69, MOD_RIGHTCONTROL, 0, PERMISSIVE_HOLD | QUICK_TAP },   // K
+    { 70, MOD_LEFTALT, 0, PERMISSIVE_HOLD | QUICK_TAP },        // L
+    { 71, MOD_RIGHTGUI, 0, PERMISSIVE_HOLD | QUICK_TAP },       // ;
+    { VOID_KEY },
+};
+
+static TapHoldKey const spaceFnKeys[] = {
+    { 91, 0, MOD_FN, HOLD_ON_OTHER_KEY_PRESS | QUICK_TAP },     // Space bar
+    { VOID_KEY },
+};
+
+static TapHoldKey const* const tapHoldKeys[HOLD_MAX + 1] = {
+    noKeys,
+    homeKeys,
+    spaceFnKeys,
+};
+
+#define MAX_HOLD_KEY_NAME   5
+
+static uint8_t const holdKeyNames[HOLD_MAX + 1][MAX_HOLD_KEY_NAME] =
+{
+    {KEY_H, KEY_O, KEY_F, KEY_F, KEY_ENTER},
+    {KEY_H, KEY_R, KEY_M, KEY_ENTER},
+    {KEY_S, KEY_F, KEY_N, KEY_ENTER},
+};
+
+static uint8_t hold;
+static uint8_t physical[KEY_BYTES];         // The keys seen at the last call
+
+/*
+ * The keys held back in the order they were pressed. A table key is listed
+ * with 1 + its table index in bufferedSlots[] until it is decided, and any
+ * other key with 0.
+ */
+static uint8_t buffered[MAX_BUFFERED];
+static uint8_t bufferedTicks[MAX_BUFFERED];
+static uint8_t bufferedSlots[MAX_BUFFERED];
+static uint16_t bufferedReleased;           // bit i is set once buffered[i] is released
+static uint8_t count;
+
+static uint8_t holding;     // bit i is set while table key i is held as modifiers
+static uint8_t tapped;      // 1 + the table index of the key tapped last, or 0
+static uint8_t tappedTick;
+
+static TapHoldStats stats;
+
+static void resetTapHold(void)
+{
+    memset(physical, 0, KEY_BYTES);
+    count = 0;
+    bufferedReleased = 0;
+    holding = 0;
+    tapped = 0;
+}
+
+void initTapHold(void)
+{
+    resetTapHold();
+    memset(&stats, 0, sizeof stats);
+}
+
+void loadTapHoldSettings(void)
+{
+    hold = ReadNvram(EEPROM_HOLD);
+    if (HOLD_MAX < hold)
+        hold = 0;
+}
+
+void emitHoldName(void)
+{
+    emitStringN(holdKeyNames[hold], MAX_HOLD_KEY_NAME);
+}
+
+void switchHold(void)
+{
+    ++hold;
+    if (HOLD_MAX < hold)
+        hold = 0;
+    WriteNvram(EEPROM_HOLD, hold);
+    resetTapHold();
+    emitHoldName();
+}
+
+static int8_t findKey(const TapHoldKey* table, uint8_t code)
+{
+    for (int8_t i = 0; table[i].code != VOID_KEY; ++i) {
+        if (table[i].code == code)
+            return i;
+    }
+    return -1;
+}
+
+static void pressKey(const TapHoldKey* table, uint8_t code)
+{
+    int8_t slot = findKey(table, code);
+
+    if (0 <= slot && tapped == slot + 1 && (table[slot].flags & QUICK_TAP))
+        slot = -1;  // Types itself again at once
+    if ((slot < 0 && !count) || count == MAX_BUFFERED)
+        return;
+    buffered[count] = code;
+    bufferedTicks[count] = stateTick;
+    bufferedSlots[count] = slot + 1;
+    ++count;
+}
+
+static void releaseKey(const TapHoldKey* table, uint8_t code)
+{
+    int8_t slot;
+
+    for (int8_t i = 0; i < count; ++i) {
+        if (buffered[i] == code)
+            bufferedReleased |= 1u << i;
+    }
+    slot = findKey(table, code);
+    if (0 <= slot)
+        holding &= ~(1u << slot);
+}
+
+static void popKey(void)
+{
+    --count;
+    memmove(buffered, buffered + 1, count);
+    memmove(bufferedTicks, bufferedTicks + 1, count);
+    memmove(bufferedSlots, bufferedSlots + 1, count);
+    bufferedReleased >>= 1;
+}
+
+static void recordDecision(int8_t held)
+{
+    uint16_t msec = (uint8_t) (stateTick - bufferedTicks[0]) * scanPeriods[scan_rate];
+
+    if (held) {
+        if (stats.holds < UINT16_MAX)
+            ++stats.holds;
+    } else if (stats.taps < UINT16_MAX)
+        ++stats.taps;
+    stats.total += msec;
+    if (stats.max < msec)
+        stats.max = msec;
+}
+
+/*
+ * Decides the table key at the head of the buffer if it can be, and lets the
+ * keys after it go in order. Returns a key released while held back, which
+ * is to be reported pressed for this scan, or VOID_KEY. At most one key is
+ * let go per scan so that the host sees the keys in the order pressed.
+ */
+static uint8_t resolveKeys(const TapHoldKey* table)
+{
+    uint8_t term = TAPPING_TERM / scanPeriods[scan_rate];
+
+    while (count) {
+        uint8_t code = buffered[0];
+        uint8_t slot = bufferedSlots[0];
+        int8_t released = bufferedReleased & 1;
+
+        if (slot) {
+            uint8_t flags = table[slot - 1].flags;
+
+            if (!released) {
+                if (count < MAX_BUFFERED && (uint8_t) (stateTick - bufferedTicks[0]) < term &&
+                    !((flags & HOLD_ON_OTHER_KEY_PRESS) && 1 < count) &&
+                    !((flags & PERMISSIVE_HOLD) && (bufferedReleased & ~1u)))
+                {
+                    break;
+                }
+                recordDecision(1);
+                holding |= 1u << (slot - 1);
+                popKey();
+                continue;
+            }
+            recordDecision(0);
+            tapped = slot;
+            tappedTick = stateTick;
+        } else if (bufferedTicks[0] != stateTick && stats.delayed < UINT16_MAX)
+            ++stats.delayed;
+        popKey();
+        return released ? code : VOID_KEY;
+    }
+    return VOID_KEY;
+}
+
+/*
+ * Turns the debounced keys[KEY_BYTES] into the keys to be processed with the
+ * table keys held applied to *mod and *modExtra. Called once per scan.
+ */
+void filterTapHold(uint8_t* keys, uint8_t* mod, uint8_t* modExtra)
+{
+    const TapHoldKey* table = tapHoldKeys[hold];
+    uint8_t forced;
+
+    if (hold == HOLD_OFF)
+        return;
+    if (tapped && QUICK_TAP_TERM / scanPeriods[scan_rate] <= (uint8_t) (stateTick - tappedTick))
+        tapped = 0;
+
+    for (int8_t i = 0; i < KEY_BYTES; ++i) {
+        uint8_t changed = keys[i] ^ physical[i];
+
+        for (int8_t b = 0; changed; ++b, changed >>= 1) {
+            if (!(changed & 1))
+                continue;
+            if (keys[i] & (1u << b))
+                pressKey(table, 8 * i + b);
+            else
+                releaseKey(table, 8 * i + b);
+        }
+        physical[i] = keys[i];
+    }
+
+    forced = resolveKeys(table);
+
+    for (int8_t i = 0; i < count; ++i)
+        keys[buffered[i] >> 3] &= ~(1u << (buffered[i] & 7));
+    for (int8_t i = 0; holding >> i; ++i) {
+        if (holding & (1u << i)) {
+            uint8_t code = table[i].code;
+
+            keys[code >> 3] &= ~(1u << (code & 7));
+            *mod |= table[i].mod;
+            *modExtra |= table[i].modExtra;
+        }
+    }
+    if (forced != VOID_KEY)
+        keys[forced >> 3] |= 1u << (forced & 7);
+}
+
+// Returns non-zero while a key is held back or can still be tapped again.
+int8_t isTapHoldBusy(void)
+{
+    return count || tapped;
+}
+
+const TapHoldStats* getTapHoldStats(void)
+{
+    return &stats;
+}
+
+#endif
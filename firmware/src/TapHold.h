@@ -0,0 +1,75 @@
+/*
+ * Copyright 2016 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TAP_HOLD_H
+#define TAP_HOLD_H
+
+#include <stdint.h>
+#include <system.h>
+
+/*
+ * Tap/hold keys
+ *
+ * A key listed in the table selected by HOLD_* types itself when tapped and
+ * acts as modifiers while held. Until it is decided which, the key and the
+ * keys pressed after it are held back; every other key goes through as it
+ * is. A key is taken as held once
+ *
+ *  - it has been held for TAPPING_TERM [msec],
+ *  - another key is pressed (HOLD_ON_OTHER_KEY_PRESS), or
+ *  - another key is pressed and released (PERMISSIVE_HOLD),
+ *
+ * and as tapped if it is released before that. A key tapped again within
+ * QUICK_TAP_TERM [msec] (QUICK_TAP) types itself at once, so that holding it
+ * repeats the key.
+ */
+
+#define HOLD_OFF        0
+#define HOLD_HOME       1   // Home row modifiers
+#define HOLD_SPACE_FN   2   // The space bar held is FN
+#define HOLD_MAX        2
+
+#define TAPPING_TERM    200 // [msec]
+#define QUICK_TAP_TERM  150 // [msec]
+
+#if APP_MACHINE_VALUE != 0x4550
+
+typedef struct TapHoldStats {
+    uint16_t taps;
+    uint16_t holds;
+    uint16_t delayed;       // Other keys held back until a decision
+    uint32_t total;         // [msec] from the press to the decision, summed up
+    uint16_t max;           // [msec]
+} TapHoldStats;
+
+void initTapHold(void);
+void loadTapHoldSettings(void);
+void emitHoldName(void);
+void switchHold(void);
+void filterTapHold(uint8_t* keys, uint8_t* mod, uint8_t* modExtra);
+int8_t isTapHoldBusy(void);
+const TapHoldStats* getTapHoldStats(void);
+
+#else
+
+#define initTapHold()
+#define loadTapHoldSettings()
+#define filterTapHold(keys, mod, modExtra)
+#define isTapHoldBusy()     0
+
+#endif
+
+#endif  // #ifndef TAP_HOLD_H
@@ -56,6 +56,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <system.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <usb/usb.h>
 #include <usb/usb_device_hid.h>
 #include <plib/timers.h>
@@ -64,8 +65,20 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "app_led_usb_status.h"
 
 #include <Keyboard.h>
+#include <Latency.h>
+#include <ReportQueue.h>
 
-#define SCAN_DELAY  (_XTAL_FREQ / 256 / 4 / 167 + 1) // About 6 [msec]
+#define TMR2_MSEC   (_XTAL_FREQ / 4 / 16 / 3 / 1000)    // Timer2 at 1:16 and 1:3
+#define TMR1_MSEC   (_XTAL_FREQ / 4 / 8 / 1000)         // Timer1 at 1:8
+#define TMR0_MSEC   (_XTAL_FREQ / 4 / 256 / 1000)       // Timer0 at 1:256
+#define TMR1_TMR0   (256 / 8)                           // Timer1 counts per Timer0 tick
+
+#define SOF_MARGIN  2   // [Timer0 ticks] between a report and the next frame
+
+#define LED_PERIOD      2   // [msec]
+#define NVRAM_PERIOD    250 // [msec]
+
+#define NKRO_USAGES 160     // Keyboard usages 0x00 to 0x9F in the report protocol
 
 // *****************************************************************************
 // *****************************************************************************
@@ -74,6 +87,8 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 // *****************************************************************************
 
 //Class specific descriptor - HID Keyboard
+//The report protocol uses a bitmap of the keys (N-key rollover). In the boot
+//protocol, the keyboard sends the 8 byte KEYBOARD_INPUT_REPORT instead.
 const struct{uint8_t report[HID_RPT01_SIZE];}hid_rpt01={
 {   0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
     0x09, 0x06,                    // USAGE (Keyboard)
@@ -98,14 +113,14 @@ const struct{uint8_t report[HID_RPT01_SIZE];}hid_rpt01={
     0x95, 0x01,                    //   REPORT_COUNT (1)
     0x75, 0x03,                    //   REPORT_SIZE (3)
     0x91, 0x03,                    //   OUTPUT (Cnst,Var,Abs)
-    0x95, 0x06,                    //   REPORT_COUNT (6)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x95, NKRO_USAGES,             //   REPORT_COUNT (160)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
     0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-    0x26, DESC_CONFIG_WORD(0xFF),  //   LOGICAL_MAXIMUM (255)
+    0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
     0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
     0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))
-    0x29, 0xFF,                    //   USAGE_MAXIMUM (Keyboard Application)
-    0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
+    0x29, NKRO_USAGES - 1,         //   USAGE_MAXIMUM (Keyboard LANG9 and beyond)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
     0xc0}                          // End Collection
 };
 
@@ -207,6 +222,17 @@ typedef struct __attribute__((packed))
 } KEYBOARD_INPUT_REPORT;
 
 
+/* This typedef defines the INPUT report in the report protocol. keys[] holds
+ * one bit for each usage from Reserved (0x00) up to NKRO_USAGES - 1, so that
+ * every key in the report from makeReport() can be sent at once. */
+typedef struct __attribute__((packed))
+{
+    uint8_t modifiers;
+    unsigned :8;
+    uint8_t keys[NKRO_USAGES / 8];
+} KEYBOARD_NKRO_REPORT;
+
+
 /* This typedef defines the only OUTPUT report found in the HID report
  * descriptor and gives an easy way to parse the OUTPUT report. */
 typedef union __attribute__((packed))
@@ -276,6 +302,16 @@ static KEYBOARD_INPUT_REPORT inputReport KEYBOARD_INPUT_REPORT_DATA_BUFFER_ADDRE
 #endif
 static volatile KEYBOARD_OUTPUT_REPORT outputReport KEYBOARD_OUTPUT_REPORT_DATA_BUFFER_ADDRESS_TAG;
 
+#if !defined(KEYBOARD_NKRO_REPORT_DATA_BUFFER_ADDRESS_TAG)
+    #define KEYBOARD_NKRO_REPORT_DATA_BUFFER_ADDRESS_TAG
+#endif
+static KEYBOARD_NKRO_REPORT nkroReport KEYBOARD_NKRO_REPORT_DATA_BUFFER_ADDRESS_TAG;
+
+// The report from makeReport() with all the keys pressed.
+static uint8_t keys[REPORT_SIZE];
+
+static uint8_t protocol = RPT_PROTOCOL;
+
 static volatile unsigned char* rowPorts[8] = {
     &TRISA,
     &TRISA,
@@ -361,122 +397,186 @@ static unsigned char rowBits6[8] = {
 };
 #endif
 
-static volatile unsigned char* columnPorts[12] = {
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-};
+/*
+ * The port and the bit each column is wired to on each board revision, from
+ * column 0. Each entry is X(column, port, bit, ...) with the arguments passed
+ * through so that the lookup tables below can be generated from these at
+ * compile time.
+ */
+#define COLUMN_PORTB    0
+#define COLUMN_PORTD    1
+
+#define COLUMN_PINS2(X, port, nibble, value) ( \
+    X(0, COLUMN_PORTD, 4, port, nibble, value) | \
+    X(1, COLUMN_PORTD, 5, port, nibble, value) | \
+    X(2, COLUMN_PORTD, 6, port, nibble, value) | \
+    X(3, COLUMN_PORTD, 7, port, nibble, value) | \
+    X(4, COLUMN_PORTD, 2, port, nibble, value) | \
+    X(5, COLUMN_PORTD, 3, port, nibble, value) | \
+    X(6, COLUMN_PORTB, 5, port, nibble, value) | \
+    X(7, COLUMN_PORTB, 4, port, nibble, value) | \
+    X(8, COLUMN_PORTB, 1, port, nibble, value) | \
+    X(9, COLUMN_PORTB, 0, port, nibble, value) | \
+    X(10, COLUMN_PORTB, 2, port, nibble, value) | \
+    X(11, COLUMN_PORTB, 3, port, nibble, value))
+
+// Rev 3
+#define COLUMN_PINS3(X, port, nibble, value) ( \
+    X(0, COLUMN_PORTD, 7, port, nibble, value) | \
+    X(1, COLUMN_PORTD, 6, port, nibble, value) | \
+    X(2, COLUMN_PORTD, 5, port, nibble, value) | \
+    X(3, COLUMN_PORTD, 4, port, nibble, value) | \
+    X(4, COLUMN_PORTD, 3, port, nibble, value) | \
+    X(5, COLUMN_PORTD, 2, port, nibble, value) | \
+    X(6, COLUMN_PORTB, 5, port, nibble, value) | \
+    X(7, COLUMN_PORTB, 4, port, nibble, value) | \
+    X(8, COLUMN_PORTB, 3, port, nibble, value) | \
+    X(9, COLUMN_PORTB, 2, port, nibble, value) | \
+    X(10, COLUMN_PORTB, 0, port, nibble, value) | \
+    X(11, COLUMN_PORTB, 1, port, nibble, value))
 
 // Rev 4
-static volatile unsigned char* columnPorts4[12] = {
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-};
+#define COLUMN_PINS4(X, port, nibble, value) ( \
+    X(0, COLUMN_PORTB, 0, port, nibble, value) | \
+    X(1, COLUMN_PORTB, 1, port, nibble, value) | \
+    X(2, COLUMN_PORTB, 2, port, nibble, value) | \
+    X(3, COLUMN_PORTB, 3, port, nibble, value) | \
+    X(4, COLUMN_PORTB, 4, port, nibble, value) | \
+    X(5, COLUMN_PORTB, 5, port, nibble, value) | \
+    X(6, COLUMN_PORTD, 7, port, nibble, value) | \
+    X(7, COLUMN_PORTD, 6, port, nibble, value) | \
+    X(8, COLUMN_PORTD, 5, port, nibble, value) | \
+    X(9, COLUMN_PORTD, 4, port, nibble, value) | \
+    X(10, COLUMN_PORTD, 1, port, nibble, value) | \
+    X(11, COLUMN_PORTD, 0, port, nibble, value))
+
+// Rev 5 swaps the last two columns of rev 4.
+#define COLUMN_PINS5(X, port, nibble, value) ( \
+    X(0, COLUMN_PORTB, 0, port, nibble, value) | \
+    X(1, COLUMN_PORTB, 1, port, nibble, value) | \
+    X(2, COLUMN_PORTB, 2, port, nibble, value) | \
+    X(3, COLUMN_PORTB, 3, port, nibble, value) | \
+    X(4, COLUMN_PORTB, 4, port, nibble, value) | \
+    X(5, COLUMN_PORTB, 5, port, nibble, value) | \
+    X(6, COLUMN_PORTD, 7, port, nibble, value) | \
+    X(7, COLUMN_PORTD, 6, port, nibble, value) | \
+    X(8, COLUMN_PORTD, 5, port, nibble, value) | \
+    X(9, COLUMN_PORTD, 4, port, nibble, value) | \
+    X(10, COLUMN_PORTD, 0, port, nibble, value) | \
+    X(11, COLUMN_PORTD, 1, port, nibble, value))
 
 #if APP_MACHINE_VALUE != 0x4550
 // Rev 6
-static volatile unsigned char* columnPorts6[12] = {
-    &PORTD,
-    &PORTD,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-    &PORTD,
-    &PORTD,
-    &PORTD,
-    &PORTB,
-    &PORTB,
-    &PORTB,
-};
+#define COLUMN_PINS6(X, port, nibble, value) ( \
+    X(0, COLUMN_PORTD, 6, port, nibble, value) | \
+    X(1, COLUMN_PORTD, 7, port, nibble, value) | \
+    X(2, COLUMN_PORTB, 0, port, nibble, value) | \
+    X(3, COLUMN_PORTB, 1, port, nibble, value) | \
+    X(4, COLUMN_PORTB, 2, port, nibble, value) | \
+    X(5, COLUMN_PORTB, 3, port, nibble, value) | \
+    X(6, COLUMN_PORTD, 1, port, nibble, value) | \
+    X(7, COLUMN_PORTD, 2, port, nibble, value) | \
+    X(8, COLUMN_PORTD, 3, port, nibble, value) | \
+    X(9, COLUMN_PORTB, 7, port, nibble, value) | \
+    X(10, COLUMN_PORTB, 6, port, nibble, value) | \
+    X(11, COLUMN_PORTB, 5, port, nibble, value))
 #endif
 
-static unsigned char columnBits[12] = {
-    1u << 4,
-    1u << 5,
-    1u << 6,
-    1u << 7,
-    1u << 2,
-    1u << 3,
-    1u << 5,
-    1u << 4,
-    1u << 1,
-    1u << 0,
-    1u << 2,
-    1u << 3,
-};
+// The column bit if the pin is one of the bits set in value read from the nibble of port
+#define COLUMN_BIT(column, pinPort, pinBit, port, nibble, value) \
+    ((pinPort) == (port) && (pinBit) / 4 == (nibble) && ((value) & (1u << (pinBit) % 4)) ? 1u << (column) : 0u)
+
+#define COLUMN_NIBBLE(pins, port, nibble) { \
+    pins(COLUMN_BIT, port, nibble, 0), pins(COLUMN_BIT, port, nibble, 1), \
+    pins(COLUMN_BIT, port, nibble, 2), pins(COLUMN_BIT, port, nibble, 3), \
+    pins(COLUMN_BIT, port, nibble, 4), pins(COLUMN_BIT, port, nibble, 5), \
+    pins(COLUMN_BIT, port, nibble, 6), pins(COLUMN_BIT, port, nibble, 7), \
+    pins(COLUMN_BIT, port, nibble, 8), pins(COLUMN_BIT, port, nibble, 9), \
+    pins(COLUMN_BIT, port, nibble, 10), pins(COLUMN_BIT, port, nibble, 11), \
+    pins(COLUMN_BIT, port, nibble, 12), pins(COLUMN_BIT, port, nibble, 13), \
+    pins(COLUMN_BIT, port, nibble, 14), pins(COLUMN_BIT, port, nibble, 15) }
+
+#define COLUMN_LUT(pins, port) { COLUMN_NIBBLE(pins, port, 0), COLUMN_NIBBLE(pins, port, 1) }
+
+// The columns read as low in each nibble of PORTB and PORTD
+static const uint16_t portBColumns2[2][16] = COLUMN_LUT(COLUMN_PINS2, COLUMN_PORTB);
+static const uint16_t portDColumns2[2][16] = COLUMN_LUT(COLUMN_PINS2, COLUMN_PORTD);
+static const uint16_t portBColumns3[2][16] = COLUMN_LUT(COLUMN_PINS3, COLUMN_PORTB);
+static const uint16_t portDColumns3[2][16] = COLUMN_LUT(COLUMN_PINS3, COLUMN_PORTD);
+static const uint16_t portBColumns4[2][16] = COLUMN_LUT(COLUMN_PINS4, COLUMN_PORTB);
+static const uint16_t portDColumns4[2][16] = COLUMN_LUT(COLUMN_PINS4, COLUMN_PORTD);
+static const uint16_t portBColumns5[2][16] = COLUMN_LUT(COLUMN_PINS5, COLUMN_PORTB);
+static const uint16_t portDColumns5[2][16] = COLUMN_LUT(COLUMN_PINS5, COLUMN_PORTD);
+#if APP_MACHINE_VALUE != 0x4550
+static const uint16_t portBColumns6[2][16] = COLUMN_LUT(COLUMN_PINS6, COLUMN_PORTB);
+static const uint16_t portDColumns6[2][16] = COLUMN_LUT(COLUMN_PINS6, COLUMN_PORTD);
+#endif
 
-// Rev 3
-static unsigned char columnBits3[12] = {
-    1u << 7,
-    1u << 6,
-    1u << 5,
-    1u << 4,
-    1u << 3,
-    1u << 2,
-    1u << 5,
-    1u << 4,
-    1u << 3,
-    1u << 2,
-    1u << 0,
-    1u << 1,
-};
+static const uint16_t (*portBColumns)[16] = portBColumns2;
+static const uint16_t (*portDColumns)[16] = portDColumns2;
 
-// Rev 4
-static unsigned char columnBits4[12] = {
-    1u << 0,
-    1u << 1,
-    1u << 2,
-    1u << 3,
-    1u << 4,
-    1u << 5,
-    1u << 7,
-    1u << 6,
-    1u << 5,
-    1u << 4,
-    1u << 1,
-    1u << 0,
-};
+static int8_t xmit = XMIT_NORMAL;
+
+// Counted up every msec by APP_KeyboardTick() from the Timer2 interrupt.
+static volatile uint8_t ticks;
 
+/*
+ * The matrix is sampled by APP_KeyboardTick() from the low priority Timer2
+ * interrupt, and the samples are handed over to scanTask() in a single
+ * producer, single consumer ring. Only the interrupt advances sampleTail and
+ * only scanTask() advances sampleHead, so neither has to lock the other out.
+ */
+#define MAX_SAMPLES 8       // Must be a power of two
+
+typedef struct Sample {
+    uint16_t tick;          // Timer0 when sampled
+    uint16_t rows[8];       // The columns pressed in each row
+} Sample;
+
+static Sample samples[MAX_SAMPLES];
+static volatile uint8_t sampleHead;
+static volatile uint8_t sampleTail;
+static uint8_t sampleCountdown;     // Ticks until the next sample
+static volatile int8_t sampleIdle;  // Set while nothing is held
+
+#if SCAN_SOF <= SCAN_MAX
+/*
+ * In SCAN_SOF, every USB start of frame arms Timer1 so that the matrix is
+ * sampled sofLead Timer0 ticks before the next frame, i.e., just early enough
+ * for the report to be in the IN endpoint when the host polls the keyboard.
+ * sofLead follows the longest time taken from a sample to its report in
+ * the last 256 samples.
+ */
+static volatile uint8_t sofLead;
+static uint8_t sofLeadMax;
+static uint8_t sofWindow;
+#endif
+
+/*
+ * The tasks APP_KeyboardTasks() runs, in this order, once every period
+ * [msec] counted in ticks, or whenever an interrupt wakes the CPU up if the
+ * period is zero. Otherwise the CPU idles.
+ */
+typedef struct Task {
+    void (*run)(void);
+    uint8_t period;
+    uint8_t last;       // ticks when run last
+} Task;
+
+static void scanTask(void);
+static void transmitTask(void);
+static void ledTask(void);
+
+static Task tasks[] = {
+    {scanTask, 0},
+    {transmitTask, 0},
+    {ledTask, LED_PERIOD},
 #if APP_MACHINE_VALUE != 0x4550
-// Rev 6
-static unsigned char columnBits6[12] = {
-    1u << 6,
-    1u << 7,
-    1u << 0,
-    1u << 1,
-    1u << 2,
-    1u << 3,
-    1u << 1,
-    1u << 2,
-    1u << 3,
-    1u << 7,
-    1u << 6,
-    1u << 5,
-};
+    {FlushNvram, NVRAM_PERIOD},
 #endif
+};
 
-static int tick;
-static int8_t xmit = XMIT_NORMAL;
+#define TASK_COUNT  (sizeof tasks / sizeof tasks[0])
 
 
 // *****************************************************************************
@@ -500,10 +600,8 @@ void APP_KeyboardConfigure(void)
             rowPorts[i] = rowPorts6[i];
             rowBits[i] = rowBits6[i];
         }
-        for (char i = 0; i < 12; ++i) {
-            columnPorts[i] = columnPorts6[i];
-            columnBits[i] = columnBits6[i];
-        }
+        portBColumns = portBColumns6;
+        portDColumns = portDColumns6;
     }
     else
 #endif
@@ -513,13 +611,12 @@ void APP_KeyboardConfigure(void)
             rowPorts[i] = rowPorts4[i];
             rowBits[i] = rowBits4[i];
         }
-        for (char i = 0; i < 12; ++i) {
-            columnPorts[i] = columnPorts4[i];
-            columnBits[i] = columnBits4[i];
-        }
         if (5 <= BOARD_REV_VALUE) {
-            columnBits[10] = 1u << 0;
-            columnBits[11] = 1u << 1;
+            portBColumns = portBColumns5;
+            portDColumns = portDColumns5;
+        } else {
+            portBColumns = portBColumns4;
+            portDColumns = portDColumns4;
         }
     }
     else if (BOARD_REV_VALUE == 3)
@@ -527,8 +624,8 @@ void APP_KeyboardConfigure(void)
         rowPorts[5] = &TRISE;
         for (char i = 0; i < 8; ++i)
             rowBits[i] = rowBits3[i];
-        for (char i = 0; i < 12; ++i)
-            columnBits[i] = columnBits3[i];
+        portBColumns = portBColumns3;
+        portDColumns = portDColumns3;
     }
 }
 
@@ -542,6 +639,11 @@ void APP_KeyboardInit(void)
     //Note OS X assumes every LED is turned off by default.
     outputReport.value = 0;
 
+    //The host switches to the boot protocol with SET_PROTOCOL if it needs to.
+    protocol = RPT_PROTOCOL;
+
+    initReportQueue();
+
     //enable the HID endpoint
     USBEnableEndpoint(HID_EP, USB_IN_ENABLED|USB_OUT_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
 
@@ -549,123 +651,334 @@ void APP_KeyboardInit(void)
     keyboard.lastOUTTransmission = HIDRxPacket(HID_EP, (uint8_t*) &outputReport, sizeof(outputReport));
 
     OpenTimer0(TIMER_INT_OFF & T0_16BIT & T0_SOURCE_INT & T0_PS_1_256);
-    tick = (int) ReadTimer0();
+
+    /* Tick the task scheduler and sample the matrix every msec;
+     * SYS_InterruptLow() calls APP_KeyboardTick() for the Timer2 interrupt,
+     * which the USB and USART interrupts at the high priority can preempt. */
+    ticks = 0;
+    for (uint8_t i = 0; i < TASK_COUNT; ++i)
+        tasks[i].last = 0;
+    sampleHead = sampleTail = 0;
+    sampleCountdown = 1;
+    sampleIdle = 0;
+    IPR1bits.TMR2IP = 0;
+    OpenTimer2(TIMER_INT_ON & T2_PS_1_16 & T2_POST_1_3);
+    PR2 = TMR2_MSEC - 1;
+
+#if SCAN_SOF <= SCAN_MAX
+    /* Timer1 runs from Fosc/4 at 1:8 and times the sample after each SOF
+     * in SCAN_SOF; see APP_KeyboardSOF(). */
+    sofLead = TMR0_MSEC / 2;
+    sofLeadMax = 0;
+    sofWindow = 0;
+    PIE1bits.TMR1IE = 0;
+    IPR1bits.TMR1IP = 0;
+    T1CON = 0;
+    T1CONbits.T1CKPS = 3;
+    T1CONbits.RD16 = 1;
+    T1CONbits.TMR1ON = 1;
+#endif
+
+    INTCONbits.GIEL = 1;
+
+#if APP_MACHINE_VALUE != 0x4550
+    /* Settings changed with the FN keys are written to the flash by
+     * the NVRAM task rather than while the keys are processed. */
+    DeferNvram();
+#endif
 }
 
-uint8_t* APP_KeyboardScan(void)
+// Stores the columns pressed in each row to rows.
+static void sampleMatrix(uint16_t* rows)
+{
+    if (!BUTTON_IsPressed()) {
+        memset(rows, 0, 8 * sizeof(uint16_t));
+        return;
+    }
+    BUTTON_Enable();
+    for (int8_t row = 7; 0 <= row; --row) {
+        uint8_t b;
+        uint8_t d;
+
+        *rowPorts[row] &= ~rowBits[row];
+        Nop(); Nop(); Nop();    // Let the columns settle
+        b = ~PORTB;
+        d = ~PORTD;
+        *rowPorts[row] |= rowBits[row];
+        rows[row] = portBColumns[0][b & 15] | portBColumns[1][b >> 4] |
+                    portDColumns[0][d & 15] | portDColumns[1][d >> 4];
+    }
+    BUTTON_Disable();
+}
+
+// Reads Timer0, which the low priority interrupt reads, too, from the main loop.
+static uint16_t readTimer0(void)
 {
-    int8_t row;
-    uint8_t column;
+    uint16_t tick;
 
-    if (xmit == XMIT_IN_ORDER) {
-        uint8_t key = peekMacro();
-        uint8_t mod = 0;
-#if APP_MACHINE_VALUE != 0x4550
-        if (key == KEYPAD_PERCENT) {
-            key = KEY_5;
-            mod = MOD_LEFTSHIFT;
-        }
+    INTCONbits.GIEL = 0;
+    tick = ReadTimer0();
+    INTCONbits.GIEL = 1;
+    return tick;
+}
+
+static void scanRows(const uint16_t* rows)
+{
+    for (int8_t row = 0; row < 8; ++row) {
+        if (rows[row])
+            onScanned(row, rows[row]);
+    }
+}
+
+// Takes a sample into the ring. Called from the low priority interrupt.
+static void takeSample(void)
+{
+    /* A full ring drops the new sample rather than an old one that
+     * scanTask() might be reading. */
+    if ((uint8_t) (sampleTail - sampleHead) < MAX_SAMPLES) {
+        Sample* sample = &samples[sampleTail & (MAX_SAMPLES - 1)];
+        sample->tick = ReadTimer0();
+        sampleMatrix(sample->rows);
+        ++sampleTail;
+    }
+}
+
+void APP_KeyboardTick(void)
+{
+    ++ticks;
+
+    /* main() polls the matrix by itself while suspended. */
+    if (USBIsDeviceSuspended())
+        return;
+
+    /* While nothing is held, sample as soon as any key goes down;
+     * BUTTON_IsPressed() samples every column with all the rows driven low.
+     * Otherwise, sample at the period of the selected scan rate. */
+    if (sampleIdle) {
+        if (!BUTTON_IsPressed())
+            return;
+        sampleIdle = 0;
+    }
+#if SCAN_SOF <= SCAN_MAX
+    else if (scan_rate == SCAN_SOF) {
+        return;     // APP_KeyboardSample() samples the matrix.
+    }
 #endif
-        switch (key) {
-        case KEY_ZQ_MACRO_TILDE:
-            key = KEY_GRAVE_ACCENT;
-            mod = MOD_LEFTSHIFT;
-            break;
-        case KEY_ZQ_MACRO_ASTERISK:
-            key = KEY_8;
-            mod = MOD_LEFTSHIFT;
-            break;
-        case KEY_ZQ_MACRO_PIPE:
-            key = KEY_BACKSLASH;
-            mod = MOD_LEFTSHIFT;
-            break;
-        case KEY_ZQ_MACRO_BANG:
-            key = KEY_1;
-            mod = MOD_LEFTSHIFT;
-            break;
-        case KEY_ZQ_MACRO_DQUOTE:
-            key = KEY_QUOTE;
-            mod = MOD_LEFTSHIFT;
-            break;
-        case KEY_ZQ_MACRO_GT:
-            key = KEY_PERIOD;
-            mod = MOD_LEFTSHIFT;
-            break;
-        case KEY_ZQ_MACRO_CAP_E:
-            key = KEY_E;
-            mod = MOD_LEFTSHIFT;
-            break;
-        }
+    else if (--sampleCountdown) {
+        return;
+    }
+    sampleCountdown = scanPeriods[scan_rate];
+    takeSample();
+}
 
-        if (inputReport.keys[0] && inputReport.keys[0] == key)
-            inputReport.keys[0] = 0;    // BRK
-        else {
-            getMacro();
-            inputReport.keys[0] = key;
-            inputReport.modifiers.value = mod;
-            if (!inputReport.keys[0])
-                xmit = XMIT_NONE;
-        }
-    } else {
-        if (BUTTON_IsPressed()) {
-            BUTTON_Enable();
-            for (row = 7; 0 <= row; --row) {
-                *rowPorts[row] &= ~rowBits[row];
-                for (column = 0; column < 12; ++column) {
-                    if (!(*columnPorts[column] & columnBits[column]))
-                        onPressed(row, column);
-                }
-                *rowPorts[row] |= rowBits[row];
-            }
-            BUTTON_Disable();
-        }
+#if SCAN_SOF <= SCAN_MAX
+/*
+ * Called for every USB start of frame from the high priority interrupt. Arms
+ * Timer1 to overflow sofLead Timer0 ticks before the next frame.
+ */
+void APP_KeyboardSOF(void)
+{
+    if (scan_rate == SCAN_SOF && !sampleIdle && !USBIsDeviceSuspended()) {
+        WriteTimer1((uint16_t) (sofLead * TMR1_TMR0 - TMR1_MSEC));
+        PIR1bits.TMR1IF = 0;
+        PIE1bits.TMR1IE = 1;
+    }
+}
 
-        xmit = makeReport((uint8_t*) &inputReport);
-        switch (xmit) {
-        case XMIT_BRK:
-            memset(&inputReport + 2, 0, 6);
-            break;
-        case XMIT_NORMAL:
-            break;
-        case XMIT_IN_ORDER:
-            for (uint8_t i = 0; i < 6; ++i)
-                emitKey(inputReport.keys[i]);
-            inputReport.keys[0] = beginMacro(6);
-            memset(inputReport.keys + 1, 0, 5);
-            break;
-        case XMIT_MACRO:
-            xmit = XMIT_IN_ORDER;
-            inputReport.modifiers.value = 0;
-            inputReport.keys[0] = beginMacro(MAX_MACRO_SIZE);
-            memset(inputReport.keys + 1, 0, 5);
-            break;
-        default:
-            break;
-        }
+// Called for the Timer1 interrupt armed by APP_KeyboardSOF().
+void APP_KeyboardSample(void)
+{
+    PIE1bits.TMR1IE = 0;
+    takeSample();
+}
+
+// Makes sofLead cover the time taken from the sample taken at tick up to now.
+static void adaptSOFLead(uint16_t tick)
+{
+    uint16_t lead = (uint16_t) (readTimer0() - tick) + SOF_MARGIN;
+
+    if (TMR0_MSEC - 1 < lead)
+        lead = TMR0_MSEC - 1;
+    if (sofLeadMax < lead)
+        sofLeadMax = (uint8_t) lead;
+    if (sofLead < lead)
+        sofLead = (uint8_t) lead;
+    if (!++sofWindow) {
+        sofLead = sofLeadMax;
+        sofLeadMax = 0;
+    }
+}
+#else
+void APP_KeyboardSOF(void)
+{
+}
+#endif
+
+// Reads the matrix in the foreground for APP_KeyboardScan().
+static void readMatrix(void)
+{
+    uint16_t rows[8];
+
+    setLatencyTick(ReadTimer0());
+    sampleMatrix(rows);
+    scanRows(rows);
+}
+
+static uint8_t* playKeys(void)
+{
+    xmit = playMacro(keys);
+    return xmit ? keys : NULL;
+}
+
+/*
+ * Processes the rows passed to onScanned() since the last call, and returns
+ * keys if the report has to be sent, or NULL otherwise.
+ */
+static uint8_t* processKeys(void)
+{
+    xmit = makeReport(keys);
+    switch (xmit) {
+    case XMIT_BRK:
+        memset(keys + 2, 0, MAX_KEYS);
+        break;
+    case XMIT_NORMAL:
+        break;
+    case XMIT_IN_ORDER:
+        for (uint8_t i = 2; i < REPORT_SIZE && keys[i]; ++i)
+            emitKey(keys[i]);
+        keys[2] = beginMacro();
+        memset(keys + 3, 0, MAX_KEYS - 1);
+        break;
+    case XMIT_MACRO:
+        xmit = XMIT_IN_ORDER;
+        keys[0] = 0;
+        keys[2] = beginMacro();
+        memset(keys + 3, 0, MAX_KEYS - 1);
+        break;
+    default:
+        break;
     }
     if (!xmit)
         return NULL;
+    return keys;
+}
+
+// Returns keys if the report has to be sent, or NULL otherwise.
+static uint8_t* scanKeys(void)
+{
+    readMatrix();
+    if (xmit == XMIT_IN_ORDER) {
+        /* Keep debouncing the matrix while the macro is played back; the key
+         * states wait in a queue until the macro is over. */
+        captureKeys();
+        return playKeys();
+    }
+    return processKeys();
+}
+
+// The boot protocol report carries the first six keys.
+static void makeBootReport(const uint8_t* report)
+{
+    inputReport.modifiers.value = report[0];
+    memcpy(inputReport.keys, report + 2, 6);
+}
+
+uint8_t* APP_KeyboardScan(void)
+{
+    uint8_t* report = scanKeys();
+
+    if (!report)
+        return NULL;
+    sendLatency(ReadTimer0());
+    makeBootReport(report);
     return (uint8_t*) &inputReport;
 }
 
-void APP_KeyboardTasks(void)
+static void makeNKROReport(const uint8_t* report)
 {
-    static int8_t cnt;
+    nkroReport.modifiers = report[0];
+    memset(nkroReport.keys, 0, sizeof nkroReport.keys);
+    for (uint8_t i = 2; i < REPORT_SIZE; ++i) {
+        uint8_t key = report[i];
+        if (key && key < NKRO_USAGES)
+            nkroReport.keys[key >> 3] |= 1u << (key & 7);
+    }
+}
 
-    while (((int) ReadTimer0()) - tick < (int) SCAN_DELAY)
-        ;
-    tick = (int) ReadTimer0();
-    if (++cnt & 1)
-        return;
+/*
+ * Processes every matrix sample taken since the last call, so that none is
+ * lost however long processing a key or a macro step has taken.
+ */
+static void scanTask(void)
+{
+    const uint8_t* report;
+
+    while (sampleHead != sampleTail) {
+        const Sample* sample = &samples[sampleHead & (MAX_SAMPLES - 1)];
+        uint16_t tick = sample->tick;
+
+        setLatencyTick(tick);
+        scanRows(sample->rows);
+        ++sampleHead;
+        if (xmit == XMIT_IN_ORDER) {
+            /* Keep debouncing the matrix while transmitTask() plays back
+             * the macro. */
+            captureKeys();
+        } else {
+            /* The reports wait in the queue until the IN endpoint takes
+             * them however the host polls the keyboard. */
+            report = processKeys();
+            if (report) {
+                queueReport(report);
+                /* A report identical to the last one is not queued, as the
+                 * host already has the keys in it. */
+                if (!peekReport())
+                    sendLatency(tick);
+            }
+        }
+#if SCAN_SOF <= SCAN_MAX
+        if (scan_rate == SCAN_SOF)
+            adaptSOFLead(tick);
+#endif
+    }
+
+    /* Let the interrupt stop sampling an empty matrix unless it has taken
+     * a new sample in the meantime. */
+    if (xmit == XMIT_NONE && isKeyboardIdle()) {
+        INTCONbits.GIEL = 0;
+        if (sampleHead == sampleTail)
+            sampleIdle = 1;
+        INTCONbits.GIEL = 1;
+    }
+}
 
-    /* Check if the IN endpoint is busy, and if it isn't check if we want to send
-     * keystroke data to the host. */
-    if (!HIDTxHandleBusy(keyboard.lastINTransmission)) {
-        uint8_t* report = APP_KeyboardScan();
-        if (report) {
-            keyboard.lastINTransmission = HIDTxPacket(HID_EP, report, sizeof(inputReport));
+static void transmitTask(void)
+{
+    const uint8_t* report;
+
+    /* Play back the macro as fast as the host takes the reports. */
+    if (xmit == XMIT_IN_ORDER && !peekReport() && (report = playKeys()))
+        queueReport(report);
+
+    /* Check if the IN endpoint is busy, and if it isn't send the oldest
+     * queued report to the host. */
+    if (!HIDTxHandleBusy(keyboard.lastINTransmission) && (report = peekReport())) {
+        if (protocol == RPT_PROTOCOL) {
+            makeNKROReport(report);
+            keyboard.lastINTransmission = HIDTxPacket(HID_EP, (uint8_t*) &nkroReport, sizeof(nkroReport));
+        } else {
+            makeBootReport(report);
+            keyboard.lastINTransmission = HIDTxPacket(HID_EP, (uint8_t*) &inputReport, sizeof(inputReport));
         }
+        dropReport();
+        if (!peekReport())
+            sendLatency(readTimer0());
     }
+}
+
+static void ledTask(void)
+{
+    APP_KeyboardProcessOutputReport();
 
     /* Check if any data was sent from the PC to the keyboard device.  Report
      * descriptor allows host to send 1 byte of data.  Bits 0-4 are LED states,
@@ -677,6 +990,34 @@ void APP_KeyboardTasks(void)
         keyboard.lastOUTTransmission = HIDRxPacket(HID_EP,(uint8_t*)&outputReport,sizeof(outputReport));
 }
 
+/*
+ * Runs the tasks that are due at the current tick, and then idles the CPU
+ * until the next interrupt, i.e., the next tick, a sample, or a USB event,
+ * unless a tick has passed or a sample has been taken in the meantime.
+ */
+void APP_KeyboardTasks(void)
+{
+    uint8_t now = ticks;
+
+    for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+        Task* task = &tasks[i];
+        if (task->period <= (uint8_t) (now - task->last)) {
+            task->last = now;
+            task->run();
+        }
+    }
+
+    /* An interrupt wakes the CPU up even while GIE is cleared, and is
+     * served once GIE is set again. */
+    INTCONbits.GIE = 0;
+    if (now == ticks && sampleHead == sampleTail) {
+        OSCCONbits.IDLEN = 1;
+        Sleep();
+        Nop();
+    }
+    INTCONbits.GIE = 1;
+}
+
 void APP_KeyboardProcessOutputReport(void)
 {
     APP_LEDUpdate(controlLED(outputReport.value));
@@ -707,6 +1048,12 @@ void USBHIDCBSetReportHandler(void)
     USBEP0Receive((uint8_t*)&CtrlTrfData, USB_EP0_BUFF_SIZE, USBHIDCBSetReportComplete);
 }
 
+void USBHIDCBSetProtocolHandler(uint8_t interfaceId, uint8_t value)
+{
+    if (interfaceId == HID_INTF_ID)
+        protocol = value;
+}
+
 /*******************************************************************************
  End of File
 */
@@ -37,6 +37,9 @@ void APP_KeyboardConfigure(void);
 void APP_KeyboardInit(void);
 uint8_t* APP_KeyboardScan(void);
 void APP_KeyboardTasks(void);
+void APP_KeyboardTick(void);
+void APP_KeyboardSOF(void);
+void APP_KeyboardSample(void);
 void APP_Suspend();
 void APP_WakeFromSuspend();
 
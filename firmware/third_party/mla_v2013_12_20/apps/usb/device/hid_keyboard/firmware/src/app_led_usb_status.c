@@ -112,7 +112,7 @@ void APP_LEDUpdateUSBStatus(void)
 
     switch (USBGetDeviceState()) {
     case CONFIGURED_STATE:
-        APP_KeyboardProcessOutputReport();
+        // Updated by the LED task in APP_KeyboardTasks().
         break;
     default:
         LED_On(LED_USB_DEVICE_HID_KEYBOARD_NUM_LOCK);
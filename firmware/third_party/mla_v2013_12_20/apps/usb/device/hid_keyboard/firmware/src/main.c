@@ -123,6 +123,7 @@ int main(void)
     {
 #ifdef WITH_HOS
         if (!isBusPowered() || !isUSBMode()) {
+            FlushNvram();
             Reset();
             Nop();
             Nop();
@@ -323,6 +324,7 @@ bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size
             break;
 
         case EVENT_SOF:
+            APP_KeyboardSOF();
             break;
 
         case EVENT_SUSPEND:
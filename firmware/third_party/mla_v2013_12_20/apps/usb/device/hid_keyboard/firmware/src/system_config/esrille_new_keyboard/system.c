@@ -57,6 +57,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <plib/usart.h>
 #include <usb/usb_device.h>
 
+#include <app_device_keyboard.h>
 #include <app_device_mouse.h>
 
 #include <Keyboard.h>
@@ -222,6 +223,14 @@ void interrupt SYS_InterruptHigh(void)
     }
 #endif
 }
+
+void interrupt low_priority SYS_InterruptLow(void)
+{
+    if (PIE1bits.TMR2IE && PIR1bits.TMR2IF) {
+        PIR1bits.TMR2IF = 0;
+        APP_KeyboardTick();
+    }
+}
 #endif
 
 /*******************************************************************************
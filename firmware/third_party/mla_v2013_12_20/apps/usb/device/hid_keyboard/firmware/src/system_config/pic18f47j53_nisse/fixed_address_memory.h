@@ -35,6 +35,7 @@
 
 #define KEYBOARD_INPUT_REPORT_DATA_BUFFER_ADDRESS_TAG   @0x500
 #define KEYBOARD_OUTPUT_REPORT_DATA_BUFFER_ADDRESS_TAG  @0x508
+#define KEYBOARD_NKRO_REPORT_DATA_BUFFER_ADDRESS_TAG    @0x510
 
 #define MOUSE_REPORT_DATA_BUFFER_ADDRESS                0x50A
 
@@ -58,6 +58,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <plib/usart.h>
 #include <usb/usb_device.h>
 
+#include <app_device_keyboard.h>
 #include <app_device_mouse.h>
 
 #include <Keyboard.h>
@@ -294,6 +295,19 @@ void interrupt SYS_InterruptHigh(void)
     }
 #endif
 }
+
+void interrupt low_priority SYS_InterruptLow(void)
+{
+    if (PIE1bits.TMR1IE && PIR1bits.TMR1IF) {
+        PIR1bits.TMR1IF = 0;
+        APP_KeyboardSample();
+    }
+
+    if (PIE1bits.TMR2IE && PIR1bits.TMR2IF) {
+        PIR1bits.TMR2IF = 0;
+        APP_KeyboardTick();
+    }
+}
 #endif
 
 
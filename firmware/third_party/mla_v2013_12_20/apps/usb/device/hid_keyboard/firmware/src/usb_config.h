@@ -136,10 +136,11 @@
 #define HID_INTF_ID                 0x00
 #define HID_EP                      1
 #define HID_INT_OUT_EP_SIZE         1
-#define HID_INT_IN_EP_SIZE          8
-#define HID_RPT01_SIZE              64
+#define HID_INT_IN_EP_SIZE          22  // 8 in the boot protocol
+#define HID_RPT01_SIZE              63
 //#define USER_GET_REPORT_HANDLER USBHIDCBGetReportHandler
 #define USER_SET_REPORT_HANDLER USBHIDCBSetReportHandler
+#define USB_DEVICE_HID_PROTOCOL_CALLBACK USBHIDCBSetProtocolHandler
 
 /* HID - Mouse */
 #define HID_MOUSE_INTF_ID           0x01
@@ -129,7 +129,7 @@ const uint8_t configDescriptor1[]={
     USB_DESCRIPTOR_ENDPOINT,    //Endpoint Descriptor
     HID_EP | _EP_IN,            //EndpointAddress
     _INTERRUPT,                       //Attributes
-    DESC_CONFIG_WORD(8),        //size
+    DESC_CONFIG_WORD(HID_INT_IN_EP_SIZE),   //size
     0x01,                        //Interval
 
     /* Endpoint Descriptor */
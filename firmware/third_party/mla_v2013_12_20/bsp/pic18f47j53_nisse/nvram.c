@@ -27,6 +27,7 @@
 
 #define PROFILE_SIZE    10
 #define PROFILE_MAX     4
+#define PROFILE_EXTRA   2   // Bytes added to each profile after PROFILE_SIZE
 
 typedef struct Profile {
     uint8_t data[PROFILE_SIZE];
@@ -34,7 +35,12 @@ typedef struct Profile {
 
 typedef struct Profiles {
     Profile profiles[PROFILE_MAX];
-    uint8_t reserved[NVRAM_BLOCK - (PROFILE_SIZE * PROFILE_MAX + 2)];
+    /*
+     * The bytes at PROFILE_SIZE and beyond are kept here so that the profiles
+     * already written keep their places.
+     */
+    uint8_t extra[PROFILE_MAX][PROFILE_EXTRA];
+    uint8_t reserved[NVRAM_BLOCK - ((PROFILE_SIZE + PROFILE_EXTRA) * PROFILE_MAX + 2)];
     uint8_t current_profile;
     uint8_t sig;    // 0x01: flashed, 0xff: erased
 } Profiles;
@@ -42,6 +48,8 @@ typedef struct Profiles {
 static const uint8_t nvramArray[NVRAM_SIZE] @ NVRAM_ADDRESS;    // Note __at() seems not working here with xc8 v1.34
 static int8_t current = -1;
 static Profiles shadow;
+static int8_t deferred;
+static int8_t dirty;
 
 static void PutNvram(void)
 {
@@ -80,24 +88,48 @@ void InitNvram(void)
             memcpy(shadow.profiles[i].data, nvram_initial_data, NVRAM_INITIAL_DATA_SIZE);
             memset(shadow.profiles[i].data + NVRAM_INITIAL_DATA_SIZE, 0, PROFILE_SIZE - NVRAM_INITIAL_DATA_SIZE);
         }
+        memset(shadow.extra, 0, sizeof shadow.extra);
     } else
         ReadFlash(NVRAM_ADDRESS + NVRAM_BLOCK * current, NVRAM_BLOCK, (void*) &shadow);
 }
 
 uint8_t ReadNvram(uint8_t offset)
 {
+    if (PROFILE_SIZE <= offset)
+        return shadow.extra[shadow.current_profile][offset - PROFILE_SIZE];
     return shadow.profiles[shadow.current_profile].data[offset];
 }
 
 void WriteNvram(uint8_t offset, uint8_t value)
 {
-    shadow.profiles[shadow.current_profile].data[offset] = value;
-    PutNvram();
+    if (PROFILE_SIZE <= offset)
+        shadow.extra[shadow.current_profile][offset - PROFILE_SIZE] = value;
+    else
+        shadow.profiles[shadow.current_profile].data[offset] = value;
+    if (deferred)
+        dirty = 1;
+    else
+        PutNvram();
+}
+
+// Lets WriteNvram() leave writing the flash to FlushNvram().
+void DeferNvram(void)
+{
+    deferred = 1;
+}
+
+void FlushNvram(void)
+{
+    if (dirty) {
+        dirty = 0;
+        PutNvram();
+    }
 }
 
 void SelectProfile(uint8_t profile)
 {
     shadow.current_profile = profile;
+    dirty = 0;
     PutNvram();
 }
 
@@ -27,6 +27,8 @@
 void InitNvram(void);
 uint8_t ReadNvram(uint8_t offset);
 void WriteNvram(uint8_t offset, uint8_t value);
+void DeferNvram(void);
+void FlushNvram(void);
 
 void SelectProfile(uint8_t profile);
 uint8_t CurrentProfile(void);
@@ -120,6 +120,12 @@ extern const struct{uint8_t report[HID_RPT02_SIZE];}hid_rpt02;
     extern void USB_DEVICE_HID_IDLE_RATE_CALLBACK(uint8_t reportId, uint8_t idleRate);
 #endif
 
+#ifndef USB_DEVICE_HID_PROTOCOL_CALLBACK
+    #define USB_DEVICE_HID_PROTOCOL_CALLBACK(interfaceId, protocol)
+#else
+    extern void USB_DEVICE_HID_PROTOCOL_CALLBACK(uint8_t interfaceId, uint8_t protocol);
+#endif
+
 /********************************************************************
 	Function:
 		void USBCheckHIDRequest(void)
@@ -265,6 +271,7 @@ void USBCheckHIDRequest(void)
         case SET_PROTOCOL:
             USBEP0Transmit(USB_EP0_NO_DATA);
             active_protocol[SetupPkt.bIntfID] = ((USB_SETUP_SET_PROTOCOL*)&SetupPkt)->protocol;
+            USB_DEVICE_HID_PROTOCOL_CALLBACK(SetupPkt.bIntfID, active_protocol[SetupPkt.bIntfID]);
             break;
     }//end switch(SetupPkt.bRequest)
 